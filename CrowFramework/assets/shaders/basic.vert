@@ -1,11 +1,19 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
-uniform vec2 uOffset;
-uniform vec2 uScale;
+// per instance
+layout (location = 1) in vec2 aOffset;
+layout (location = 2) in vec2 aScale;
+layout (location = 3) in vec3 aColor;
+
+// world (NDC at the default window size) -> clip, keeps the playfield aspect on resize
+uniform vec2 uViewScale;
+
+out vec3 vColor;
 
 void main()
 {
-    vec2 p = aPos.xy * uScale + uOffset;
-    gl_Position = vec4(p, 0.0, 1.0);
+    vec2 p = aPos.xy * aScale + aOffset;
+    gl_Position = vec4(p * uViewScale, 0.0, 1.0);
+    vColor = aColor;
 }
\ No newline at end of file
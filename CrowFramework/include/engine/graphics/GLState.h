@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/// Counters for calls forwarded to GL vs. skipped as redundant.
+struct GLStateStats
+{
+    uint64_t programBinds = 0, programSkips = 0;
+    uint64_t vaoBinds = 0, vaoSkips = 0;
+    uint64_t bufferBinds = 0, bufferSkips = 0;
+    uint64_t unitSwitches = 0, unitSkips = 0;
+    uint64_t textureBinds = 0, textureSkips = 0;
+    uint64_t uniformSets = 0, uniformSkips = 0;
+
+    uint64_t TotalSkips() const { return programSkips + vaoSkips + bufferSkips + unitSkips + textureSkips + uniformSkips; }
+};
+
+/// Shadow of the GL binding state for the current context.
+/// - Program, VAO, buffer, texture and per-program uniform values
+/// - Calls that would not change state are skipped (and counted)
+/// - Code that talks to GL directly (gl2d, imgui) should be followed by Invalidate()
+/// - GL_ELEMENT_ARRAY_BUFFER is VAO state and is never cached
+class GLStateCache
+{
+public:
+    static GLStateCache& Get();
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vao);
+    void BindBuffer(GLenum target, GLuint buffer);
+    void ActiveTexture(GLenum unit);               // GL_TEXTURE0 + n
+    void BindTexture(GLenum target, GLuint texture); // on the active unit
+
+    // Uniform setters for the program currently in use
+    void Uniform1i(GLint loc, int v);
+    void Uniform1f(GLint loc, float v);
+    void Uniform2f(GLint loc, float x, float y);
+    void Uniform3f(GLint loc, float x, float y, float z);
+    void Uniform4f(GLint loc, float x, float y, float z, float w);
+    void UniformMatrix4fv(GLint loc, const float* m);
+
+    GLuint CurrentProgram() const { return program; }
+
+    /// Record a binding made with plain glBindBuffer (e.g. inside gl2d::StreamBuffer).
+    void NoteBufferBinding(GLenum target, GLuint buffer);
+
+    // Call after deleting objects so a recycled name isn't mistaken for the old one
+    void ForgetProgram(GLuint program);
+    void ForgetVertexArray(GLuint vao);
+    void ForgetBuffer(GLuint buffer);
+    void ForgetTexture(GLuint texture);
+
+    /// Forget everything (e.g. after third-party code changed GL state behind our back).
+    void Invalidate();
+
+    const GLStateStats& Stats() const { return stats; }
+    void ResetStats() { stats = {}; }
+
+private:
+    static constexpr GLuint kUnknown = 0xFFFFFFFFu;
+    static constexpr int kTextureUnits = 16;
+
+    enum BufferSlot { ArrayBuffer, UniformBuffer, CopyReadBuffer, CopyWriteBuffer, PixelUnpackBuffer, BufferSlotCount };
+    enum TextureSlot { Texture2D, Texture2DArray, TextureSlotCount };
+
+    struct UniformValue
+    {
+        int count = 0; // floats (ints are stored bitwise) in use, 0 = unknown
+        float v[16];
+    };
+
+    GLuint program = kUnknown;
+    GLuint vao = kUnknown;
+    GLuint buffers[BufferSlotCount];
+    GLenum activeUnit = kUnknown;
+    GLuint textures[kTextureUnits][TextureSlotCount];
+
+    std::unordered_map<GLuint, std::vector<UniformValue>> uniformValues;
+
+    GLStateStats stats;
+
+    GLStateCache() { Invalidate(); }
+
+    static int BufferSlotOf(GLenum target);
+    static int TextureSlotOf(GLenum target);
+
+    // true if the value differs from the shadow (and records it)
+    bool UniformChanged(GLint loc, const float* v, int count);
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <gl2d/gl2d.h>
+#include <cstddef>
+#include <vector>
+
+class Shader;
+
+/// Per-instance data for one rect (matches basic.vert attributes 1..3).
+struct RectInstance
+{
+    float x, y;    // center
+    float w, h;    // size
+    float r, g, b; // color
+};
+
+/// Instanced rect renderer.
+/// - One static unit quad + per-instance data (offset, scale, color)
+/// - Instances are streamed through a fenced ring buffer (gl2d::StreamBuffer)
+/// - Add() rects on the CPU, Draw() issues a single glDrawArraysInstanced
+class RectBatch
+{
+public:
+    RectBatch() = default;
+    ~RectBatch();
+
+    RectBatch(const RectBatch&) = delete;
+    RectBatch& operator=(const RectBatch&) = delete;
+
+    /// Needs a current GL context. capacity = instances per frame the ring starts with.
+    bool Create(size_t capacity = 256);
+
+    void Clear() { instances.clear(); }
+    void Add(float x, float y, float w, float h, float r, float g, float b)
+    {
+        instances.push_back({ x, y, w, h, r, g, b });
+    }
+
+    size_t Count() const { return instances.size(); }
+
+    void Draw(const Shader& shader);
+
+    /// Frees the GL objects (call while the context is still alive).
+    void Destroy();
+
+private:
+    GLuint vao = 0;
+    GLuint quadVbo = 0;
+    gl2d::StreamBuffer instanceStream;
+
+    std::vector<RectInstance> instances;
+};
@@ -1,13 +1,33 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
 #include <string>
-#include <unordered_map>
+#include <vector>
+
+#include "engine/graphics/GLState.h"
+
+/// Uniform location resolved once, typed by the value it accepts.
+/// Setting through a handle does no name lookup.
+template <typename T>
+struct UniformHandle
+{
+    GLint location = -1;
+    bool IsValid() const { return location != -1; }
+};
+
+using UniformFloat = UniformHandle<float>;
+using UniformInt = UniformHandle<int>;
+using UniformVec2 = UniformHandle<glm::vec2>;
+using UniformVec3 = UniformHandle<glm::vec3>;
+using UniformVec4 = UniformHandle<glm::vec4>;
+using UniformMat4 = UniformHandle<glm::mat4>;
 
 /// Thin shader wrapper (file-based).
 /// - Loads .vert/.frag files
 /// - Compiles + links program
-/// - Uniform setters with cached locations
+/// - Reflects active uniforms after link (name, type, location)
+/// - Typed uniform handles; string setters kept for convenience
 class Shader
 {
 public:
@@ -22,20 +42,61 @@ public:
     Shader& operator=(Shader&& other) noexcept;
 
     bool IsValid() const { return program != 0; }
+    GLuint Id() const { return program; }
     void Use() const;
 
+    /// Resolve a uniform once (e.g. at load time). Returns an invalid handle and logs
+    /// if the uniform is not active or its GLSL type doesn't match T.
+    template <typename T>
+    UniformHandle<T> Uniform(const char* name) const
+    {
+        UniformHandle<T> h;
+        h.location = ReflectedLoc(name, UniformTypeOf((T*)nullptr));
+        return h;
+    }
+
+    // Handle setters (program must be in use; unchanged values are skipped by GLStateCache)
+    void Set(UniformFloat u, float v) const { if (u.IsValid()) GLStateCache::Get().Uniform1f(u.location, v); }
+    void Set(UniformInt u, int v) const { if (u.IsValid()) GLStateCache::Get().Uniform1i(u.location, v); }
+    void Set(UniformVec2 u, const glm::vec2& v) const { if (u.IsValid()) GLStateCache::Get().Uniform2f(u.location, v.x, v.y); }
+    void Set(UniformVec3 u, const glm::vec3& v) const { if (u.IsValid()) GLStateCache::Get().Uniform3f(u.location, v.x, v.y, v.z); }
+    void Set(UniformVec4 u, const glm::vec4& v) const { if (u.IsValid()) GLStateCache::Get().Uniform4f(u.location, v.x, v.y, v.z, v.w); }
+    void Set(UniformMat4 u, const glm::mat4& v) const { if (u.IsValid()) GLStateCache::Get().UniformMatrix4fv(u.location, &v[0][0]); }
+
+    // Name-based setters (compatibility; linear lookup in the reflected list, no allocation)
     void SetVec2(const char* name, float x, float y);
     void SetVec3(const char* name, float x, float y, float z);
 
+    struct UniformInfo
+    {
+        std::string name; // without a trailing "[0]" for arrays
+        GLenum type = 0;
+        GLint location = -1;
+        GLint size = 0;   // array length
+    };
+
+    const std::vector<UniformInfo>& Uniforms() const { return uniforms; }
+
 private:
     GLuint program = 0;
-    std::unordered_map<std::string, GLint> locCache;
+    std::vector<UniformInfo> uniforms;
+
+    static GLenum UniformTypeOf(float*) { return GL_FLOAT; }
+    static GLenum UniformTypeOf(int*) { return GL_INT; }
+    static GLenum UniformTypeOf(glm::vec2*) { return GL_FLOAT_VEC2; }
+    static GLenum UniformTypeOf(glm::vec3*) { return GL_FLOAT_VEC3; }
+    static GLenum UniformTypeOf(glm::vec4*) { return GL_FLOAT_VEC4; }
+    static GLenum UniformTypeOf(glm::mat4*) { return GL_FLOAT_MAT4; }
 
     static std::string LoadTextFile(const char* path);
     static GLuint Compile(GLenum type, const char* src, const char* label);
     static bool PrintShaderLogIfFailed(GLuint shader, const char* label);
     static bool PrintProgramLogIfFailed(GLuint program);
 
-    GLint Loc(const char* name);
+    void Reflect();
+    const UniformInfo* Find(const char* name) const;
+    GLint ReflectedLoc(const char* name, GLenum expectedType) const;
+
+    GLint Loc(const char* name) const;
     void Destroy();
 };
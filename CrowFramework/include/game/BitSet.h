@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace bits
+{
+    inline int PopCount(uint64_t v)
+    {
+#ifdef _MSC_VER
+    #ifdef _M_X64
+        return (int)__popcnt64(v);
+    #else
+        return (int)(__popcnt((uint32_t)v) + __popcnt((uint32_t)(v >> 32)));
+    #endif
+#else
+        return __builtin_popcountll(v);
+#endif
+    }
+
+    // index of the lowest set bit, v must not be 0
+    inline int CountTrailingZeros(uint64_t v)
+    {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+    #ifdef _M_X64
+        _BitScanForward64(&index, v);
+    #else
+        if ((uint32_t)v) _BitScanForward(&index, (uint32_t)v);
+        else { _BitScanForward(&index, (uint32_t)(v >> 32)); index += 32; }
+    #endif
+        return (int)index;
+#else
+        return __builtin_ctzll(v);
+#endif
+    }
+}
+
+/// Fixed-size bit set backed by 64-bit words.
+/// - Count() uses popcount, ForEachSet() walks set bits with ctz
+/// - Bits past Size() in the last word are always 0
+class BitSet
+{
+public:
+    void Resize(size_t bitCount, bool value)
+    {
+        size = bitCount;
+        words.assign((bitCount + 63) / 64, value ? ~0ull : 0ull);
+        TrimTail();
+    }
+
+    size_t Size() const { return size; }
+
+    bool Test(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1ull; }
+    void Set(size_t i) { words[i >> 6] |= 1ull << (i & 63); }
+    void Reset(size_t i) { words[i >> 6] &= ~(1ull << (i & 63)); }
+
+    /// Bits [8 * i, 8 * i + 8) as one byte.
+    uint8_t Byte(size_t i) const { return (uint8_t)(words[i >> 3] >> ((i & 7) * 8)); }
+
+    int Count() const
+    {
+        int n = 0;
+        for (uint64_t w : words) n += bits::PopCount(w);
+        return n;
+    }
+
+    bool None() const
+    {
+        for (uint64_t w : words) if (w) return false;
+        return true;
+    }
+
+    /// Calls fn(index) for every set bit, in increasing index order.
+    template <typename Fn>
+    void ForEachSet(Fn&& fn) const
+    {
+        for (size_t wi = 0; wi < words.size(); ++wi)
+        {
+            uint64_t w = words[wi];
+            while (w)
+            {
+                fn((wi << 6) + (size_t)bits::CountTrailingZeros(w));
+                w &= w - 1; // clear lowest set bit
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t> words;
+    size_t size = 0;
+
+    void TrimTail()
+    {
+        if (size & 63) words.back() &= (1ull << (size & 63)) - 1;
+    }
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/// Uniform grid over the brick lattice laid out by BuildBricks.
+/// - One cell per lattice slot (brick + the gap around it)
+/// - A cell holds the index of its brick, or -1 when empty
+/// - Queries only visit the cells an AABB overlaps, so cost doesn't grow with field size
+struct BrickGrid
+{
+    float originX = 0.0f; // left edge of column 0
+    float originY = 0.0f; // top edge of row 0 (rows go downwards)
+    float cellW = 0.0f;
+    float cellH = 0.0f;
+    int cols = 0;
+    int rows = 0;
+
+    std::vector<int> cells;
+
+    void Reset(float originX, float originY, float cellW, float cellH, int cols, int rows);
+    void Clear();
+
+    int& At(int col, int row) { return cells[(size_t)row * cols + col]; }
+    int At(int col, int row) const { return cells[(size_t)row * cols + col]; }
+
+    /// Inclusive cell range overlapped by the AABB; returns false if it misses the grid.
+    bool CellRange(float minX, float minY, float maxX, float maxY,
+        int& col0, int& row0, int& col1, int& row1) const;
+};
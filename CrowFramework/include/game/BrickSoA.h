@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include "game/BitSet.h"
+
+struct Brick;
+
+/// Brick geometry as structure-of-arrays, for vectorized passes.
+/// - Same indices as World::bricks
+/// - x / y are centers, halfW / halfH half extents
+/// - Arrays are padded to a multiple of kLanes with far-away empty bricks,
+///   so kernels can always process whole blocks
+struct BrickSoA
+{
+    static constexpr int kLanes = 8;
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> halfW;
+    std::vector<float> halfH;
+
+    int count = 0;
+
+    void Build(const std::vector<Brick>& bricks);
+    int PaddedCount() const { return (int)x.size(); }
+};
+
+/// Index of the first alive brick (at or after first) whose box overlaps the AABB, or -1.
+/// Uses AVX2 / SSE2 when the build targets them, scalar code otherwise.
+int FindFirstOverlap(const BrickSoA& soa, const BitSet& alive,
+    float minX, float minY, float maxX, float maxY, int first = 0);
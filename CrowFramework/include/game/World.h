@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+
+#include "game/BitSet.h"
+#include "game/BrickGrid.h"
+#include "game/BrickSoA.h"
+
+/// Headless Breakout simulation.
+/// - Plain data, no GLFW / GL dependencies
+/// - Shared by the windowed game and the headless runner
+struct Brick
+{
+    float x, y;
+    float w, h;
+    float r, g, b;
+};
+
+/// Simulation rate. Step() is always called with kFixedDt so results don't
+/// depend on the render frame rate.
+static constexpr float kSimulationHz = 240.0f;
+static constexpr float kFixedDt = 1.0f / kSimulationHz;
+
+/// Per-step player input.
+struct Input
+{
+    float paddleDir = 0.0f; // -1 (left) .. 1 (right)
+};
+
+struct World
+{
+    // White background + slightly inset black playfield (thin white "wall")
+    float playW = 1.94f;
+    float playH = 1.98f;
+    float playX = 0.0f;
+    float playY = -0.01f;
+
+    // Paddle
+    float paddleX = 0.0f;
+    float paddleY = -0.88f;
+    float paddleW = 0.25f;
+    float paddleH = 0.06f;
+    float paddleSpeed = 1.6f;
+
+    // Ball
+    float ballX = 0.0f;
+    float ballY = -0.2f;
+    float ballSize = 0.04f;
+    float ballVX = 0.7f;
+    float ballVY = 1.0f;
+
+    // Positions at the start of the last step (for render interpolation)
+    float prevPaddleX = 0.0f;
+    float prevBallX = 0.0f;
+    float prevBallY = -0.2f;
+
+    // Brick lattice (custom layouts can go far beyond the default 14x8)
+    int brickCols = 14;
+    int brickRows = 8;
+
+    // Bricks keep their slot for the whole round; destroyed ones are cleared
+    // in brickAlive, so indices stay valid for the grid and other systems.
+    std::vector<Brick> bricks;
+    BitSet brickAlive;
+    BrickGrid brickGrid;
+    BrickSoA brickSoA;
+
+    // true: test only the grid cells under the ball; false: SIMD brute force over all bricks
+    bool useBrickGrid = true;
+
+    int score = 0;
+
+    float LeftWall() const { return playX - playW * 0.5f; }
+    float RightWall() const { return playX + playW * 0.5f; }
+    float TopWall() const { return playY + playH * 0.5f; }
+
+    int BricksLeft() const { return brickAlive.Count(); }
+};
+
+/// Positions to draw, blended between the last two simulation steps.
+struct WorldView
+{
+    float paddleX;
+    float ballX, ballY;
+};
+
+/// Resets paddle, ball and score and lays out the default brick field.
+void InitWorld(World& world);
+
+/// Lays out cols x rows bricks in the top part of the playfield, marks them all alive
+/// and indexes them in grid.
+void BuildBricks(std::vector<Brick>& bricks, BitSet& alive, BrickGrid& grid,
+    float playX, float playY, float playW, float playH,
+    int cols = 14, int rows = 8);
+
+/// Advances the simulation by dt seconds.
+void Step(World& world, const Input& input, float dt);
+
+/// alpha in [0, 1]: how far the render time is between the previous and the current step.
+WorldView Interpolate(const World& world, float alpha);
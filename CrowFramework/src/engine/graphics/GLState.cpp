@@ -0,0 +1,173 @@
+#include "engine/graphics/GLState.h"
+
+#include <cstring>
+
+GLStateCache& GLStateCache::Get()
+{
+    static GLStateCache cache;
+    return cache;
+}
+
+int GLStateCache::BufferSlotOf(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER:        return ArrayBuffer;
+    case GL_UNIFORM_BUFFER:      return UniformBuffer;
+    case GL_COPY_READ_BUFFER:    return CopyReadBuffer;
+    case GL_COPY_WRITE_BUFFER:   return CopyWriteBuffer;
+    case GL_PIXEL_UNPACK_BUFFER: return PixelUnpackBuffer;
+    default:                     return -1;
+    }
+}
+
+int GLStateCache::TextureSlotOf(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D:       return Texture2D;
+    case GL_TEXTURE_2D_ARRAY: return Texture2DArray;
+    default:                  return -1;
+    }
+}
+
+void GLStateCache::Invalidate()
+{
+    program = kUnknown;
+    vao = kUnknown;
+    activeUnit = kUnknown;
+    for (auto& b : buffers) b = kUnknown;
+    for (auto& unit : textures)
+        for (auto& t : unit) t = kUnknown;
+    uniformValues.clear();
+}
+
+void GLStateCache::UseProgram(GLuint p)
+{
+    if (p == program) { ++stats.programSkips; return; }
+    glUseProgram(p);
+    program = p;
+    ++stats.programBinds;
+}
+
+void GLStateCache::BindVertexArray(GLuint v)
+{
+    if (v == vao) { ++stats.vaoSkips; return; }
+    glBindVertexArray(v);
+    vao = v;
+    ++stats.vaoBinds;
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+    const int slot = BufferSlotOf(target);
+    if (slot >= 0 && buffers[slot] == buffer) { ++stats.bufferSkips; return; }
+    glBindBuffer(target, buffer);
+    if (slot >= 0) buffers[slot] = buffer;
+    ++stats.bufferBinds;
+}
+
+void GLStateCache::NoteBufferBinding(GLenum target, GLuint buffer)
+{
+    const int slot = BufferSlotOf(target);
+    if (slot >= 0) buffers[slot] = buffer;
+}
+
+void GLStateCache::ActiveTexture(GLenum unit)
+{
+    if (unit == activeUnit) { ++stats.unitSkips; return; }
+    glActiveTexture(unit);
+    activeUnit = unit;
+    ++stats.unitSwitches;
+}
+
+void GLStateCache::BindTexture(GLenum target, GLuint texture)
+{
+    const int slot = TextureSlotOf(target);
+    const int unit = (activeUnit == kUnknown) ? -1 : (int)(activeUnit - GL_TEXTURE0);
+    const bool tracked = slot >= 0 && unit >= 0 && unit < kTextureUnits;
+
+    if (tracked && textures[unit][slot] == texture) { ++stats.textureSkips; return; }
+    glBindTexture(target, texture);
+    if (tracked) textures[unit][slot] = texture;
+    ++stats.textureBinds;
+}
+
+bool GLStateCache::UniformChanged(GLint loc, const float* v, int count)
+{
+    if (loc < 0 || program == kUnknown) return true;
+
+    auto& values = uniformValues[program];
+    if ((size_t)loc >= values.size()) values.resize((size_t)loc + 1);
+
+    UniformValue& shadow = values[(size_t)loc];
+    if (shadow.count == count && std::memcmp(shadow.v, v, sizeof(float) * (size_t)count) == 0)
+    {
+        ++stats.uniformSkips;
+        return false;
+    }
+
+    shadow.count = count;
+    std::memcpy(shadow.v, v, sizeof(float) * (size_t)count);
+    ++stats.uniformSets;
+    return true;
+}
+
+void GLStateCache::Uniform1i(GLint loc, int v)
+{
+    float bitsAsFloat;
+    std::memcpy(&bitsAsFloat, &v, sizeof(float));
+    if (UniformChanged(loc, &bitsAsFloat, 1)) glUniform1i(loc, v);
+}
+
+void GLStateCache::Uniform1f(GLint loc, float v)
+{
+    if (UniformChanged(loc, &v, 1)) glUniform1f(loc, v);
+}
+
+void GLStateCache::Uniform2f(GLint loc, float x, float y)
+{
+    const float v[2] = { x, y };
+    if (UniformChanged(loc, v, 2)) glUniform2f(loc, x, y);
+}
+
+void GLStateCache::Uniform3f(GLint loc, float x, float y, float z)
+{
+    const float v[3] = { x, y, z };
+    if (UniformChanged(loc, v, 3)) glUniform3f(loc, x, y, z);
+}
+
+void GLStateCache::Uniform4f(GLint loc, float x, float y, float z, float w)
+{
+    const float v[4] = { x, y, z, w };
+    if (UniformChanged(loc, v, 4)) glUniform4f(loc, x, y, z, w);
+}
+
+void GLStateCache::UniformMatrix4fv(GLint loc, const float* m)
+{
+    if (UniformChanged(loc, m, 16)) glUniformMatrix4fv(loc, 1, GL_FALSE, m);
+}
+
+void GLStateCache::ForgetProgram(GLuint p)
+{
+    uniformValues.erase(p);
+    if (program == p) program = kUnknown;
+}
+
+void GLStateCache::ForgetVertexArray(GLuint v)
+{
+    if (vao == v) vao = kUnknown;
+}
+
+void GLStateCache::ForgetBuffer(GLuint buffer)
+{
+    for (auto& b : buffers)
+        if (b == buffer) b = kUnknown;
+}
+
+void GLStateCache::ForgetTexture(GLuint texture)
+{
+    for (auto& unit : textures)
+        for (auto& t : unit)
+            if (t == texture) t = kUnknown;
+}
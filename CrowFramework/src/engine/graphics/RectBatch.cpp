@@ -0,0 +1,86 @@
+#include "engine/graphics/RectBatch.h"
+#include "engine/graphics/GLState.h"
+#include "engine/graphics/Shader.h"
+
+// Unit rect centered at origin (scaled/offset per instance in basic.vert)
+static const float rectVerts[] = {
+    -0.5f,-0.5f,0.0f,
+     0.5f,-0.5f,0.0f,
+     0.5f, 0.5f,0.0f,
+    -0.5f,-0.5f,0.0f,
+     0.5f, 0.5f,0.0f,
+    -0.5f, 0.5f,0.0f
+};
+
+RectBatch::~RectBatch()
+{
+    Destroy();
+}
+
+void RectBatch::Destroy()
+{
+    GLStateCache& gl = GLStateCache::Get();
+    if (instanceStream.buffer) { gl.ForgetBuffer(instanceStream.buffer); instanceStream.cleanup(); }
+    if (quadVbo) { gl.ForgetBuffer(quadVbo); glDeleteBuffers(1, &quadVbo); }
+    if (vao) { gl.ForgetVertexArray(vao); glDeleteVertexArrays(1, &vao); }
+    quadVbo = vao = 0;
+}
+
+bool RectBatch::Create(size_t capacity)
+{
+    Destroy();
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &quadVbo);
+    if (!vao || !quadVbo)
+    {
+        Destroy();
+        return false;
+    }
+
+    GLStateCache& gl = GLStateCache::Get();
+    gl.BindVertexArray(vao);
+
+    gl.BindBuffer(GL_ARRAY_BUFFER, quadVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(rectVerts), rectVerts, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // instance attributes are pointed into the stream at draw time
+    if (!capacity) capacity = 1;
+    instanceStream.create(capacity * sizeof(RectInstance));
+    gl.NoteBufferBinding(GL_ARRAY_BUFFER, instanceStream.buffer);
+
+    for (GLuint a = 1; a <= 3; ++a)
+    {
+        glEnableVertexAttribArray(a);
+        glVertexAttribDivisor(a, 1);
+    }
+
+    instances.reserve(capacity);
+    return true;
+}
+
+void RectBatch::Draw(const Shader& shader)
+{
+    if (instances.empty() || !vao) return;
+
+    const size_t bytes = instances.size() * sizeof(RectInstance);
+
+    GLStateCache& gl = GLStateCache::Get();
+
+    // no reallocation and no GPU stall: the ring hands out a region the GPU is done with
+    const size_t offset = instanceStream.upload(instances.data(), bytes);
+    gl.NoteBufferBinding(GL_ARRAY_BUFFER, instanceStream.buffer);
+
+    // bindings are left in place; GLStateCache skips them next frame
+    shader.Use();
+    gl.BindVertexArray(vao);
+
+    const GLsizei stride = sizeof(RectInstance);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(RectInstance, x)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(RectInstance, w)));
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(RectInstance, r)));
+
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)instances.size());
+}
@@ -1,5 +1,6 @@
 #include "engine/graphics/Shader.h"
 
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -96,7 +97,10 @@ Shader::Shader(const char* vertPath, const char* fragPath)
     {
         glDeleteProgram(program);
         program = 0;
+        return;
     }
+
+    Reflect();
 }
 
 Shader::~Shader()
@@ -107,7 +111,7 @@ Shader::~Shader()
 Shader::Shader(Shader&& other) noexcept
 {
     program = other.program;
-    locCache = std::move(other.locCache);
+    uniforms = std::move(other.uniforms);
     other.program = 0;
 }
 
@@ -116,7 +120,7 @@ Shader& Shader::operator=(Shader&& other) noexcept
     if (this == &other) return *this;
     Destroy();
     program = other.program;
-    locCache = std::move(other.locCache);
+    uniforms = std::move(other.uniforms);
     other.program = 0;
     return *this;
 }
@@ -125,35 +129,94 @@ void Shader::Destroy()
 {
     if (program)
     {
+        GLStateCache::Get().ForgetProgram(program);
         glDeleteProgram(program);
         program = 0;
     }
-    locCache.clear();
+    uniforms.clear();
 }
 
 void Shader::Use() const
 {
-    glUseProgram(program);
+    GLStateCache::Get().UseProgram(program);
 }
 
-GLint Shader::Loc(const char* name)
+void Shader::Reflect()
 {
-    auto it = locCache.find(name);
-    if (it != locCache.end()) return it->second;
+    uniforms.clear();
+
+    GLint count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    GLint maxLen = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLen);
+
+    std::string name((size_t)maxLen + 1, '\0');
+    uniforms.reserve((size_t)count);
+
+    for (GLint i = 0; i < count; ++i)
+    {
+        GLsizei len = 0;
+        UniformInfo info;
+        glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), &len, &info.size, &info.type, name.data());
+
+        info.name.assign(name.data(), (size_t)len);
+        info.location = glGetUniformLocation(program, info.name.c_str());
 
-    GLint loc = glGetUniformLocation(program, name);
-    locCache.emplace(name, loc);
-    return loc;
+        // arrays are reported as "name[0]"; look them up by the plain name
+        const size_t bracket = info.name.find('[');
+        if (bracket != std::string::npos) info.name.resize(bracket);
+
+        // uniform block members have no location
+        if (info.location == -1) continue;
+
+        uniforms.push_back(std::move(info));
+    }
+}
+
+const Shader::UniformInfo* Shader::Find(const char* name) const
+{
+    for (const auto& u : uniforms)
+    {
+        if (std::strcmp(u.name.c_str(), name) == 0) return &u;
+    }
+    return nullptr;
+}
+
+GLint Shader::ReflectedLoc(const char* name, GLenum expectedType) const
+{
+    const UniformInfo* u = Find(name);
+    if (!u)
+    {
+        std::cout << "[Shader Uniform] not active: " << name << "\n";
+        return -1;
+    }
+
+    // int handles also accept samplers
+    const bool samplerAsInt = expectedType == GL_INT &&
+        (u->type == GL_SAMPLER_2D || u->type == GL_SAMPLER_2D_ARRAY || u->type == GL_SAMPLER_CUBE);
+
+    if (u->type != expectedType && !samplerAsInt)
+    {
+        std::cout << "[Shader Uniform] type mismatch: " << name << "\n";
+        return -1;
+    }
+    return u->location;
+}
+
+GLint Shader::Loc(const char* name) const
+{
+    const UniformInfo* u = Find(name);
+    return u ? u->location : -1;
 }
 
 void Shader::SetVec2(const char* name, float x, float y)
 {
     GLint loc = Loc(name);
-    if (loc != -1) glUniform2f(loc, x, y);
+    if (loc != -1) GLStateCache::Get().Uniform2f(loc, x, y);
 }
 
 void Shader::SetVec3(const char* name, float x, float y, float z)
 {
     GLint loc = Loc(name);
-    if (loc != -1) glUniform3f(loc, x, y, z);
+    if (loc != -1) GLStateCache::Get().Uniform3f(loc, x, y, z);
 }
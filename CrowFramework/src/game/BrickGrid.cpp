@@ -0,0 +1,39 @@
+#include "game/BrickGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+void BrickGrid::Reset(float originX_, float originY_, float cellW_, float cellH_, int cols_, int rows_)
+{
+    originX = originX_;
+    originY = originY_;
+    cellW = cellW_;
+    cellH = cellH_;
+    cols = cols_;
+    rows = rows_;
+    cells.assign((size_t)cols * rows, -1);
+}
+
+void BrickGrid::Clear()
+{
+    std::fill(cells.begin(), cells.end(), -1);
+}
+
+bool BrickGrid::CellRange(float minX, float minY, float maxX, float maxY,
+    int& col0, int& row0, int& col1, int& row1) const
+{
+    if (cols == 0 || rows == 0) return false;
+
+    col0 = (int)std::floor((minX - originX) / cellW);
+    col1 = (int)std::floor((maxX - originX) / cellW);
+    row0 = (int)std::floor((originY - maxY) / cellH);
+    row1 = (int)std::floor((originY - minY) / cellH);
+
+    if (col1 < 0 || col0 >= cols || row1 < 0 || row0 >= rows) return false;
+
+    col0 = std::max(col0, 0);
+    row0 = std::max(row0, 0);
+    col1 = std::min(col1, cols - 1);
+    row1 = std::min(row1, rows - 1);
+    return true;
+}
@@ -0,0 +1,104 @@
+#include "game/BrickSoA.h"
+#include "game/World.h"
+
+#if defined(__AVX2__)
+#define BRICK_SIMD_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BRICK_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// padding bricks sit here so they never overlap anything
+static constexpr float kFarAway = 1.0e30f;
+
+void BrickSoA::Build(const std::vector<Brick>& bricks)
+{
+    count = (int)bricks.size();
+    const size_t padded = ((size_t)count + kLanes - 1) / kLanes * kLanes;
+
+    x.assign(padded, kFarAway);
+    y.assign(padded, kFarAway);
+    halfW.assign(padded, 0.0f);
+    halfH.assign(padded, 0.0f);
+
+    for (int i = 0; i < count; ++i)
+    {
+        x[i] = bricks[i].x;
+        y[i] = bricks[i].y;
+        halfW[i] = bricks[i].w * 0.5f;
+        halfH[i] = bricks[i].h * 0.5f;
+    }
+}
+
+// overlap bits for the 8 bricks starting at base (bit i = brick base + i)
+static unsigned OverlapMask8(const BrickSoA& soa, int base,
+    float minX, float minY, float maxX, float maxY)
+{
+#if BRICK_SIMD_AVX2
+    const __m256 bx = _mm256_loadu_ps(&soa.x[base]);
+    const __m256 by = _mm256_loadu_ps(&soa.y[base]);
+    const __m256 hw = _mm256_loadu_ps(&soa.halfW[base]);
+    const __m256 hh = _mm256_loadu_ps(&soa.halfH[base]);
+
+    // same comparisons as BallVsAABB: max >= box min && min <= box max
+    __m256 m = _mm256_cmp_ps(_mm256_set1_ps(maxX), _mm256_sub_ps(bx, hw), _CMP_GE_OQ);
+    m = _mm256_and_ps(m, _mm256_cmp_ps(_mm256_set1_ps(minX), _mm256_add_ps(bx, hw), _CMP_LE_OQ));
+    m = _mm256_and_ps(m, _mm256_cmp_ps(_mm256_set1_ps(maxY), _mm256_sub_ps(by, hh), _CMP_GE_OQ));
+    m = _mm256_and_ps(m, _mm256_cmp_ps(_mm256_set1_ps(minY), _mm256_add_ps(by, hh), _CMP_LE_OQ));
+    return (unsigned)_mm256_movemask_ps(m);
+#elif BRICK_SIMD_SSE2
+    const __m128 minX4 = _mm_set1_ps(minX);
+    const __m128 minY4 = _mm_set1_ps(minY);
+    const __m128 maxX4 = _mm_set1_ps(maxX);
+    const __m128 maxY4 = _mm_set1_ps(maxY);
+
+    unsigned mask = 0;
+    for (int half = 0; half < 2; ++half)
+    {
+        const int i = base + half * 4;
+        const __m128 bx = _mm_loadu_ps(&soa.x[i]);
+        const __m128 by = _mm_loadu_ps(&soa.y[i]);
+        const __m128 hw = _mm_loadu_ps(&soa.halfW[i]);
+        const __m128 hh = _mm_loadu_ps(&soa.halfH[i]);
+
+        __m128 m = _mm_cmpge_ps(maxX4, _mm_sub_ps(bx, hw));
+        m = _mm_and_ps(m, _mm_cmple_ps(minX4, _mm_add_ps(bx, hw)));
+        m = _mm_and_ps(m, _mm_cmpge_ps(maxY4, _mm_sub_ps(by, hh)));
+        m = _mm_and_ps(m, _mm_cmple_ps(minY4, _mm_add_ps(by, hh)));
+        mask |= (unsigned)_mm_movemask_ps(m) << (half * 4);
+    }
+    return mask;
+#else
+    unsigned mask = 0;
+    for (int l = 0; l < BrickSoA::kLanes; ++l)
+    {
+        const int i = base + l;
+        const bool overlap = maxX >= (soa.x[i] - soa.halfW[i]) && minX <= (soa.x[i] + soa.halfW[i]) &&
+            maxY >= (soa.y[i] - soa.halfH[i]) && minY <= (soa.y[i] + soa.halfH[i]);
+        mask |= (unsigned)overlap << l;
+    }
+    return mask;
+#endif
+}
+
+int FindFirstOverlap(const BrickSoA& soa, const BitSet& alive,
+    float minX, float minY, float maxX, float maxY, int first)
+{
+    static_assert(BrickSoA::kLanes == 8, "blocks map to one byte of the alive mask");
+
+    const int padded = soa.PaddedCount();
+    for (int base = first & ~(BrickSoA::kLanes - 1); base < padded; base += BrickSoA::kLanes)
+    {
+        unsigned live = alive.Byte((size_t)base / 8);
+        if (base < first) live &= ~0u << (first - base);
+        if (!live) continue; // whole block destroyed
+
+        const unsigned hits = OverlapMask8(soa, base, minX, minY, maxX, maxY) & live;
+        if (hits)
+        {
+            return base + bits::CountTrailingZeros(hits);
+        }
+    }
+    return -1;
+}
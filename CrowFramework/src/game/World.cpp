@@ -0,0 +1,260 @@
+#include "game/World.h"
+
+#include <algorithm>
+#include <cmath>
+
+static void ResetBall(World& world)
+{
+    world.ballX = 0.0f;
+    world.ballY = -0.2f;
+    world.ballVX = 0.7f;
+    world.ballVY = 1.0f;
+
+    // teleport: don't interpolate across the reset
+    world.prevBallX = world.ballX;
+    world.prevBallY = world.ballY;
+}
+
+void InitWorld(World& world)
+{
+    world.paddleX = 0.0f;
+    world.prevPaddleX = world.paddleX;
+    ResetBall(world);
+    world.score = 0;
+    BuildBricks(world.bricks, world.brickAlive, world.brickGrid, world.playX, world.playY, world.playW, world.playH,
+        world.brickCols, world.brickRows);
+    world.brickSoA.Build(world.bricks);
+}
+
+void BuildBricks(std::vector<Brick>& bricks, BitSet& alive, BrickGrid& grid,
+    float playX, float playY, float playW, float playH,
+    int cols, int rows)
+{
+    bricks.clear();
+
+    const int bands = 4;
+
+    // playfield bounds
+    const float left = playX - playW * 0.5f;
+    const float right = playX + playW * 0.5f;
+    const float top = playY + playH * 0.5f;
+
+    // Atari-ish: bricks start below top, leaving a top "score band" area
+    const float scoreBandH = 0.18f;
+    const float bricksTop = top - scoreBandH;
+
+    // Make bricks fill width nicely: small side margin, tiny gaps
+    const float marginX = 0.02f;
+    const float marginTop = 0.06f;
+
+    const float gapX = 0.006f;
+    const float gapY = 0.012f;
+
+    const float areaW = (right - left) - marginX * 2.0f;
+    const float areaH = 0.42f; // tweak: taller brick field
+
+    const float brickW = (areaW - gapX * (cols - 1)) / cols;
+    const float brickH = (areaH - gapY * (rows - 1)) / rows;
+
+    const float startX = left + marginX + brickW * 0.5f;
+    const float startY = bricksTop - marginTop - brickH * 0.5f;
+
+    // Colors (Atari-ish order from TOP: red/orange/green/yellow)
+    const float colors[bands][3] = {
+        { 0.86f, 0.10f, 0.10f }, // red
+        { 0.92f, 0.55f, 0.10f }, // orange
+        { 0.10f, 0.70f, 0.20f }, // green
+        { 0.90f, 0.85f, 0.15f }, // yellow
+    };
+
+    bricks.reserve((size_t)cols * rows);
+
+    // one grid cell per lattice slot, centered on its brick
+    const float pitchX = brickW + gapX;
+    const float pitchY = brickH + gapY;
+    grid.Reset(startX - pitchX * 0.5f, startY + pitchY * 0.5f, pitchX, pitchY, cols, rows);
+
+    for (int r = 0; r < rows; ++r)
+    {
+        const int band = r * bands / rows; // 0..3
+        const float rr = colors[band][0];
+        const float gg = colors[band][1];
+        const float bb = colors[band][2];
+
+        const float y = startY - r * pitchY;
+
+        for (int c = 0; c < cols; ++c)
+        {
+            const float x = startX + c * pitchX;
+
+            Brick b;
+            b.x = x; b.y = y;
+            b.w = brickW; b.h = brickH;
+            b.r = rr; b.g = gg; b.b = bb;
+            grid.At(c, r) = (int)bricks.size();
+            bricks.push_back(b);
+        }
+    }
+
+    alive.Resize(bricks.size(), true);
+}
+
+// returns true if hit; also resolves by pushing ball out + reflecting on minimal penetration axis
+static bool BallVsAABB(float& ballX, float& ballY, float ballHalf,
+    float& ballVX, float& ballVY,
+    const Brick& box)
+{
+    const float halfW = box.w * 0.5f;
+    const float halfH = box.h * 0.5f;
+
+    const bool overlapX = (ballX + ballHalf) >= (box.x - halfW) &&
+        (ballX - ballHalf) <= (box.x + halfW);
+    const bool overlapY = (ballY + ballHalf) >= (box.y - halfH) &&
+        (ballY - ballHalf) <= (box.y + halfH);
+
+    if (!(overlapX && overlapY)) return false;
+
+    // penetration
+    const float dx = ballX - box.x;
+    const float px = (halfW + ballHalf) - std::abs(dx);
+
+    const float dy = ballY - box.y;
+    const float py = (halfH + ballHalf) - std::abs(dy);
+
+    if (px < py)
+    {
+        // resolve X
+        ballVX *= -1.0f;
+        ballX += (dx > 0.0f) ? px : -px;
+    }
+    else
+    {
+        // resolve Y
+        ballVY *= -1.0f;
+        ballY += (dy > 0.0f) ? py : -py;
+    }
+    return true;
+}
+
+// Tests the ball only against bricks in the grid cells its AABB overlaps.
+// Cells are visited in brick order, so the first hit matches a linear scan.
+// Returns the index of the brick that was hit, or -1.
+static int CollideBricksGrid(World& world, float halfBall)
+{
+    const BrickGrid& grid = world.brickGrid;
+
+    int col0 = 0, row0 = 0, col1 = 0, row1 = 0;
+    if (!grid.CellRange(world.ballX - halfBall, world.ballY - halfBall,
+        world.ballX + halfBall, world.ballY + halfBall,
+        col0, row0, col1, row1))
+    {
+        return -1;
+    }
+
+    for (int r = row0; r <= row1; ++r)
+    {
+        for (int c = col0; c <= col1; ++c)
+        {
+            const int index = grid.At(c, r);
+            if (index < 0 || !world.brickAlive.Test((size_t)index)) continue;
+
+            if (BallVsAABB(world.ballX, world.ballY, halfBall, world.ballVX, world.ballVY, world.bricks[index]))
+            {
+                return index;
+            }
+        }
+    }
+    return -1;
+}
+
+// Brute force over the SoA geometry, 8 bricks per test. Same first hit as the grid path.
+static int CollideBricksSoA(World& world, float halfBall)
+{
+    int index = -1;
+    while ((index = FindFirstOverlap(world.brickSoA, world.brickAlive,
+        world.ballX - halfBall, world.ballY - halfBall,
+        world.ballX + halfBall, world.ballY + halfBall, index + 1)) >= 0)
+    {
+        if (BallVsAABB(world.ballX, world.ballY, halfBall, world.ballVX, world.ballVY, world.bricks[index]))
+        {
+            return index;
+        }
+    }
+    return -1;
+}
+
+void Step(World& world, const Input& input, float dt)
+{
+    const float leftWall = world.LeftWall();
+    const float rightWall = world.RightWall();
+    const float topWall = world.TopWall();
+
+    world.prevPaddleX = world.paddleX;
+    world.prevBallX = world.ballX;
+    world.prevBallY = world.ballY;
+
+    // ----- input -----
+    world.paddleX += input.paddleDir * world.paddleSpeed * dt;
+
+    const float halfPW = world.paddleW * 0.5f;
+    world.paddleX = std::clamp(world.paddleX, leftWall + halfPW, rightWall - halfPW);
+
+    // ----- update -----
+    const float halfBall = world.ballSize * 0.5f;
+
+    // move
+    world.ballX += world.ballVX * dt;
+    world.ballY += world.ballVY * dt;
+
+    // walls (no bottom wall)
+    if (world.ballY + halfBall > topWall) { world.ballY = topWall - halfBall;   world.ballVY *= -1.0f; }
+    if (world.ballX - halfBall < leftWall) { world.ballX = leftWall + halfBall;  world.ballVX *= -1.0f; }
+    if (world.ballX + halfBall > rightWall) { world.ballX = rightWall - halfBall; world.ballVX *= -1.0f; }
+
+    // paddle AABB (only when falling)
+    const float halfPH = world.paddleH * 0.5f;
+    const bool pOverlapX = (world.ballX + halfBall) >= (world.paddleX - halfPW) &&
+        (world.ballX - halfBall) <= (world.paddleX + halfPW);
+    const bool pOverlapY = (world.ballY - halfBall) <= (world.paddleY + halfPH) &&
+        (world.ballY + halfBall) >= (world.paddleY - halfPH);
+
+    if (pOverlapX && pOverlapY && world.ballVY < 0.0f)
+    {
+        // snap to top of paddle to avoid "sticky gap" feeling
+        world.ballY = world.paddleY + halfPH + halfBall;
+
+        world.ballVY *= -1.0f;
+
+        // angle control (Atari-ish)
+        float offset = (world.ballX - world.paddleX) / halfPW;  // -1..1
+        offset = std::clamp(offset, -1.0f, 1.0f);
+
+        world.ballVX = offset * 1.2f;
+
+        // prevent too-straight vertical
+        if (std::abs(world.ballVX) < 0.2f) world.ballVX = (world.ballVX < 0.0f) ? -0.2f : 0.2f;
+    }
+
+    // brick collision: first hit only per step (simple + stable)
+    const int hit = world.useBrickGrid ? CollideBricksGrid(world, halfBall) : CollideBricksSoA(world, halfBall);
+    if (hit >= 0)
+    {
+        world.brickAlive.Reset((size_t)hit);
+        world.score += 10;
+    }
+
+    // reset if ball falls below screen
+    if (world.ballY < -1.0f - halfBall)
+    {
+        ResetBall(world);
+    }
+}
+
+WorldView Interpolate(const World& world, float alpha)
+{
+    WorldView view;
+    view.paddleX = world.prevPaddleX + (world.paddleX - world.prevPaddleX) * alpha;
+    view.ballX = world.prevBallX + (world.ballX - world.prevBallX) * alpha;
+    view.ballY = world.prevBallY + (world.ballY - world.prevBallY) * alpha;
+    return view;
+}
@@ -0,0 +1,87 @@
+// GLStateCache: redundant binds and uniform uploads must be skipped, counted,
+// and never reach GL. The GL calls go to fakes so no context is needed.
+#include "engine/graphics/GLState.h"
+
+#include <cstdio>
+
+static int glCalls = 0;
+
+static void APIENTRY FakeUseProgram(GLuint) { ++glCalls; }
+static void APIENTRY FakeBindVertexArray(GLuint) { ++glCalls; }
+static void APIENTRY FakeBindBuffer(GLenum, GLuint) { ++glCalls; }
+static void APIENTRY FakeActiveTexture(GLenum) { ++glCalls; }
+static void APIENTRY FakeBindTexture(GLenum, GLuint) { ++glCalls; }
+static void APIENTRY FakeUniform2f(GLint, GLfloat, GLfloat) { ++glCalls; }
+
+static int failures = 0;
+
+static void Check(bool ok, const char* what, unsigned long long value)
+{
+    if (!ok)
+    {
+        std::printf("FAIL %s (got %llu)\n", what, value);
+        failures++;
+    }
+}
+
+int main()
+{
+    glad_glUseProgram = FakeUseProgram;
+    glad_glBindVertexArray = FakeBindVertexArray;
+    glad_glBindBuffer = FakeBindBuffer;
+    glad_glActiveTexture = FakeActiveTexture;
+    glad_glBindTexture = FakeBindTexture;
+    glad_glUniform2f = FakeUniform2f;
+
+    GLStateCache& gl = GLStateCache::Get();
+    gl.Invalidate();
+    gl.ResetStats();
+
+    // The game's frame: Use + view scale in main, then RectBatch::Draw binds again.
+    // Only the first frame has anything to send.
+    const int frames = 100;
+    for (int f = 0; f < frames; ++f)
+    {
+        gl.UseProgram(3);
+        gl.Uniform2f(0, 1.0f, 0.75f);
+        gl.UseProgram(3);
+        gl.BindVertexArray(5);
+        gl.BindBuffer(GL_ARRAY_BUFFER, 7);
+        gl.ActiveTexture(GL_TEXTURE0);
+        gl.BindTexture(GL_TEXTURE_2D, 9);
+    }
+
+    const GLStateStats& s = gl.Stats();
+    Check(s.programBinds == 1, "program bound once", s.programBinds);
+    Check(s.programSkips == 2 * frames - 1, "program rebinds skipped", s.programSkips);
+    Check(s.uniformSets == 1, "uniform uploaded once", s.uniformSets);
+    Check(s.uniformSkips == frames - 1, "unchanged uniform skipped", s.uniformSkips);
+    Check(s.vaoSkips == frames - 1, "vao rebinds skipped", s.vaoSkips);
+    Check(s.bufferSkips == frames - 1, "buffer rebinds skipped", s.bufferSkips);
+    Check(s.unitSwitches == 1, "active unit set once", s.unitSwitches);
+    Check(s.unitSkips == frames - 1, "active unit repeats skipped", s.unitSkips);
+    Check(s.textureSkips == frames - 1, "texture rebinds skipped", s.textureSkips);
+    Check(glCalls == 6, "only the first frame reaches GL", (unsigned long long)glCalls);
+
+    // a changed value goes through, and the shadow is per program
+    gl.Uniform2f(0, 0.5f, 1.0f);
+    Check(s.uniformSets == 2, "changed uniform uploaded", s.uniformSets);
+    gl.UseProgram(4);
+    gl.Uniform2f(0, 0.5f, 1.0f);
+    Check(s.uniformSets == 3, "other program has its own uniform values", s.uniformSets);
+
+    // after Invalidate nothing is assumed
+    gl.Invalidate();
+    const int before = glCalls;
+    gl.UseProgram(4);
+    gl.ActiveTexture(GL_TEXTURE0);
+    Check(glCalls == before + 2, "invalidated state is sent again", (unsigned long long)(glCalls - before));
+
+    if (failures)
+    {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("glStateCacheTest passed (%llu calls skipped)\n", (unsigned long long)s.TotalSkips());
+    return 0;
+}
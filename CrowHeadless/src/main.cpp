@@ -0,0 +1,103 @@
+// Headless Breakout runner.
+// Steps the simulation as fast as the CPU allows (no window, no GL context)
+// and reports throughput in steps/sec.
+//
+// usage: CrowHeadless [steps per world] [worlds] [brick cols] [brick rows] [grid|simd]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "game/World.h"
+
+static constexpr long long kDefaultSteps = 10'000'000;
+
+// simple autopilot: keep the paddle under the ball
+static Input AutoPilot(const World& world)
+{
+    Input input;
+    const float dx = world.ballX - world.paddleX;
+    if (dx < -0.01f) input.paddleDir = -1.0f;
+    if (dx > 0.01f) input.paddleDir = 1.0f;
+    return input;
+}
+
+// one world per cache line group so worker threads don't false-share
+struct alignas(64) WorldSlot
+{
+    World world;
+};
+
+static void RunWorld(World& world, long long steps)
+{
+    InitWorld(world);
+
+    for (long long i = 0; i < steps; ++i)
+    {
+        Step(world, AutoPilot(world), kFixedDt);
+
+        // cleared the field: start over so the workload stays comparable
+        if (world.brickAlive.None())
+        {
+            InitWorld(world);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const long long steps = (argc > 1) ? std::atoll(argv[1]) : kDefaultSteps;
+    const int worldCount = (argc > 2) ? std::atoi(argv[2]) : 1;
+    const int brickCols = (argc > 3) ? std::atoi(argv[3]) : 14;
+    const int brickRows = (argc > 4) ? std::atoi(argv[4]) : 8;
+    const bool useGrid = (argc > 5) ? std::strcmp(argv[5], "simd") != 0 : true;
+
+    if (steps <= 0 || worldCount <= 0 || brickCols <= 0 || brickRows <= 0)
+    {
+        std::printf("usage: %s [steps per world] [worlds] [brick cols] [brick rows] [grid|simd]\n", argv[0]);
+        return -1;
+    }
+
+    std::vector<WorldSlot> worlds((size_t)worldCount);
+    for (auto& w : worlds)
+    {
+        w.world.brickCols = brickCols;
+        w.world.brickRows = brickRows;
+        w.world.useBrickGrid = useGrid;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    if (worldCount == 1)
+    {
+        RunWorld(worlds[0].world, steps);
+    }
+    else
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(worlds.size());
+        for (auto& w : worlds)
+        {
+            threads.emplace_back(RunWorld, std::ref(w.world), steps);
+        }
+        for (auto& t : threads) t.join();
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    const double totalSteps = (double)steps * worldCount;
+
+    long long score = 0;
+    for (const auto& w : worlds) score += w.world.score;
+
+    std::printf("worlds: %d  bricks: %dx%d (%s)  steps/world: %lld  time: %.3fs\n",
+        worldCount, brickCols, brickRows, useGrid ? "grid" : "simd", steps, seconds);
+    std::printf("steps/sec: %.0f  (%.0f per world)\n",
+        totalSteps / seconds, (double)steps / seconds);
+    std::printf("checksum score: %lld\n", score);
+    return 0;
+}
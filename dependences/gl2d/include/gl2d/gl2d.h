@@ -40,6 +40,13 @@
 //if this is true it will use opengl130. If not it will use fome functionality from opengl3.
 #define GL2D_USE_OPENGL_130 false
 
+//if this is true per frame vertex data is streamed through a persistent mapped buffer (glBufferStorage)
+//when the driver supports it. If not (or if unsupported) it uses glMapBufferRange with GL_MAP_UNSYNCHRONIZED_BIT.
+#define GL2D_USE_PERSISTENT_MAPPING true
+
+//how many textures the multi texture batching mode binds for one draw (gl 3.3 guarantees 16 units)
+#define GL2D_MAX_BATCH_TEXTURES 8
+
 #define GL2D_DEFAULT_TEXTURE_LOAD_MODE_PIXELATED false
 #define GL2D_DEFAULT_TEXTURE_LOAD_MODE_USE_MIPMAPS true
 
@@ -58,6 +65,7 @@
 #include <stb_image/stb_image.h>
 #include <stb_truetype/stb_truetype.h>
 #include <vector>
+#include <cstdint>
 
 namespace gl2d
 {
@@ -86,8 +94,9 @@ namespace gl2d
 
 	struct ShaderProgram
 	{
-		GLuint id;
-		int u_sampler;
+		GLuint id = 0;
+		int u_sampler = -1;
+		int u_viewProjection = -1; //-1 if the vertex shader doesn't use it, the camera is then applied on the cpu
 	};
 
 	ShaderProgram createShaderProgram(const char *vertex, const char *fragment);
@@ -281,6 +290,9 @@ namespace gl2d
 		//todo not tested, add rotation
 		//glm::mat3 getMatrix();
 
+		//gl2d pixels to clip space for a w x h target, the matrix the renderer gives u_viewProjection
+		glm::mat4 getViewProjection(float w, float h) const;
+
 		//Used to follow objects (player for example).
 		//The followed object (pos) will get placed in the center of the screen.
 		//Min is the minimum distance
@@ -321,15 +333,78 @@ namespace gl2d
 	};
 
 
-	enum Renderer2DBufferType
+	//Ring buffer for data that is rewritten every frame (vertices, instances).
+	//The storage is split in 3 regions, each one fenced with glFenceSync when the writer moves past it,
+	//so the cpu never overwrites data the gpu is still reading and the driver never reallocates.
+	//Uses a persistent coherent mapping (glBufferStorage) when available,
+	//else falls back to glMapBufferRange with GL_MAP_UNSYNCHRONIZED_BIT (opengl 3.3).
+	struct StreamBuffer
+	{
+		static constexpr int REGIONS = 3;
+
+		GLuint buffer = 0;
+		GLenum target = GL_ARRAY_BUFFER;
+		size_t regionSize = 0;
+		size_t head = 0;
+		int region = 0; //the region head writes in, head alone is ambiguous when a region is filled exactly
+		GLsync fences[REGIONS] = {};
+		char *persistentPtr = 0;
+		bool persistent = false;
+
+		//bytesPerRegion is roughly the data written in one frame, it grows if needed.
+		void create(size_t bytesPerRegion, GLenum target = GL_ARRAY_BUFFER);
+		void cleanup();
+
+		//Reserves size bytes and returns a pointer to write them to, call endWrite after.
+		//outOffset is the byte offset in the buffer (for attrib pointers / draw calls).
+		//Binds the buffer to its target.
+		void *beginWrite(size_t size, size_t &outOffset);
+		void endWrite();
+
+		//beginWrite + memcpy + endWrite, returns the byte offset.
+		size_t upload(const void *data, size_t size);
+
+		//internal
+		size_t alloc(size_t size);
+		void grow(size_t minRegionSize);
+		void waitRegion(int region);
+		void allocateStorage();
+	};
+
+	//one corner of a quad, the 4 corners are written together and indexed
+	struct Vertex2D
+	{
+		glm::vec2 position;
+		glm::vec4 color;
+		glm::vec2 texturePosition;
+	};
+
+	//How Renderer2D lays out vertices in the gpu buffer. The cpu side always uses Vertex2D,
+	//the compact formats are packed while copying into the stream buffer at flush.
+	enum Renderer2DVertexFormat
 	{
-		quadPositions,
-		quadColors,
-		texturePositions,
+		vertexFormatFloat = 0,		//32 bytes: vec2 position, vec4 color, vec2 texcoord
+		vertexFormatRGBA8,			//20 bytes: vec2 position, normalized RGBA8 color, vec2 texcoord
+		vertexFormatRGBA8HalfUV,	//16 bytes: vec2 position, normalized RGBA8 color, half float texcoord
+		vertexFormatRGBA8NoUV,		//12 bytes: vec2 position, normalized RGBA8 color. For renderers that only draw
+									//untextured quads, a texture would be sampled at its corner only
+	};
+
+	//size in bytes of one vertex in the gpu buffer
+	size_t vertexFormatStride(Renderer2DVertexFormat format);
 
-		bufferSize
+	//compact sprite for Renderer2D::renderQuads
+	struct QuadDescriptor
+	{
+		Rect rect = {}; //x y w h in pixels
+		float rotation = 0; //degrees, around the rect center
+		Color4f color = {1,1,1,1};
+		glm::vec4 textureCoords = GL2D_DefaultTextureCoords;
+		GLuint texture = 0; //0 means untextured
 	};
 
+	struct RenderCommandList;
+
 	struct Renderer2D
 	{
 		Renderer2D() {};
@@ -345,7 +420,8 @@ namespace gl2d
 		//fbo is the default frame buffer, 0 means drawing to the screen.
 		//Quad count is the reserved quad capacity for drawing.
 		//If the capacity is exceded it will be extended but this will cost performance.
-		void create(GLuint fbo = 0, size_t quadCount = 1'000);
+		//vertexFormat selects a compact gpu vertex layout to cut the upload size, see Renderer2DVertexFormat.
+		void create(GLuint fbo = 0, size_t quadCount = 1'000, Renderer2DVertexFormat vertexFormat = vertexFormatFloat);
 
 		//Clears the object alocated resources but
 		//does not clear resources allocated by user like textures, fonts and fbos!
@@ -353,24 +429,127 @@ namespace gl2d
 
 		GLuint defaultFBO = 0;
 
-		GLuint buffers[Renderer2DBufferType::bufferSize] = {};
+		//all the per flush vertex data is streamed through here
+		StreamBuffer vertexStream;
 		GLuint vao = {};
+		Renderer2DVertexFormat vertexFormat = vertexFormatFloat;
 
-		//4 elements each component
-		std::vector<glm::vec2>spritePositions;
-		std::vector<glm::vec4>spriteColors;
-		std::vector<glm::vec2>texturePositions;
-		std::vector<Texture>spriteTextures;
-		
-		//glm::vec2 spritePositions[GL2D_Renderer2D_Max_Triangle_Capacity * 6];
-		//glm::vec4 spriteColors[GL2D_Renderer2D_Max_Triangle_Capacity * 6];
-		//glm::vec2 texturePositions[GL2D_Renderer2D_Max_Triangle_Capacity * 6];
-		//Texture   spriteTextures[GL2D_Renderer2D_Max_Triangle_Capacity * 6];
+		//static index buffer (0 1 3, 1 2 3 per quad) shared by every quad
+		GLuint quadIndexBuffer = 0;
+		size_t quadIndexCapacity = 0; //in quads
+		void ensureQuadIndices(size_t quadCount);
+
+		//4 interleaved vertices per quad
+		std::vector<Vertex2D> spriteVertices;
+		//1 texture id per quad
+		std::vector<GLuint> spriteTextures;
+
+		//Multi texture batching: up to GL2D_MAX_BATCH_TEXTURES textures are bound to separate units
+		//and every vertex carries the unit to sample, so texture changes don't split the draw.
+		//Only used with the default shader, custom shaders still get one draw per texture run.
+		bool multiTextureBatching = false;
+		void setMultiTextureBatching(bool enable) { multiTextureBatching = enable; }
 
-		//int spritePositionsCount = 0;
-		//int spriteColorsCount = 0;
-		//int texturePositionsCount = 0;
-		//int spriteTexturesCount = 0;
+		struct TextureBatch
+		{
+			size_t firstQuad = 0;
+			size_t quadCount = 0;
+			int textureCount = 0;
+			GLuint textures[GL2D_MAX_BATCH_TEXTURES] = {};
+		};
+
+		//filled at flush, kept to avoid reallocating
+		std::vector<TextureBatch> textureBatches;
+		std::vector<unsigned char> spriteTextureSlots; //1 per vertex
+
+		//Render queue: when enabled every quad gets a 64 bit key (layer, shader, texture, depth)
+		//and flush radix sorts the quads by it, so submission order no longer decides the state changes.
+		//Quads with equal keys keep their submission order.
+		bool sortedRendering = false;
+		void setSortedRendering(bool enable) { sortedRendering = enable; }
+
+		//higher layers are drawn on top, used as the most significant part of the key
+		unsigned short currentLayer = 0;
+		void setRenderLayer(unsigned short layer) { currentLayer = layer; }
+
+		//0..1, orders quads that share layer, shader and texture
+		float currentDepth = 0;
+		void setRenderDepth(float depth) { currentDepth = depth; }
+
+		//Quads are pushed in world space, the camera (and the shader with sortedRendering)
+		//they were submitted with is kept here once and turned into a view projection uniform at flush.
+		struct RenderState
+		{
+			ShaderProgram shader = {};
+			Camera camera = {};
+			int windowW = 0;
+			int windowH = 0;
+			glm::vec4 viewBounds = {}; //min x, min y, max x, max y of what the camera sees, in vertex space
+		};
+		std::vector<RenderState> renderStates;
+		unsigned int lastRenderState = 0;
+		unsigned int currentRenderState();
+
+		//without sortedRendering: the quad where the render state changes
+		struct StateChange
+		{
+			size_t firstQuad = 0;
+			unsigned int state = 0;
+		};
+		std::vector<StateChange> stateChanges;
+
+		std::vector<std::uint64_t> spriteSortKeys; //1 per quad, only filled with sortedRendering
+
+		//consecutive quads drawn with the same shader and camera, filled at flush
+		struct DrawRun
+		{
+			size_t firstQuad = 0;
+			size_t quadCount = 0;
+			ShaderProgram shader = {};
+			glm::mat4 viewProjection = glm::mat4(1.f);
+			bool multiTexture = false;
+			size_t firstBatch = 0;
+			size_t batchCount = 0;
+		};
+		std::vector<DrawRun> drawRuns;
+
+		//scratch for the sort
+		std::vector<std::uint64_t> sortKeysScratch;
+		std::vector<std::uint32_t> sortIndices;
+		std::vector<std::uint32_t> sortIndicesScratch;
+		std::vector<Vertex2D> sortVerticesScratch;
+		std::vector<GLuint> sortTexturesScratch;
+
+		//Drops quads whose bounding box is fully outside the camera view before they get vertices.
+		//Conservative: it uses the rotated view bounds as an axis aligned box.
+		bool viewCulling = false;
+		void setViewCulling(bool enable) { viewCulling = enable; }
+		size_t culledQuads = 0; //since the last clearDrawData
+		std::vector<QuadDescriptor> cullScratch;
+
+		struct FlushStats
+		{
+			size_t quads = 0;
+			size_t culledQuads = 0;
+			int batchesBeforeSort = 0; //draws submission order would need (shader, camera or texture changes)
+			int drawCalls = 0; //draws actually issued
+		};
+
+		//filled by the last flush
+		FlushStats lastFlushStats = {};
+
+		//appends one quad (4 vertices in index buffer order) with its texture, and its sort key if needed
+		void submitQuad(const Vertex2D quad[4], GLuint texture);
+
+		//Bulk version of renderRectangle (rotation around the center, one color per quad).
+		//The corners of 4 quads at a time are computed with simd and written straight into the vertex data.
+		void renderQuads(const QuadDescriptor *quads, size_t count);
+
+		//Appends command lists filled on other threads, in the order given, with the current shader and camera.
+		//With sortedRendering the quads get their keys here and are sort merged at flush.
+		//Call it on the render thread once the workers are done with the lists.
+		void submitCommandLists(const RenderCommandList *lists, size_t count);
+		void submitCommandList(const RenderCommandList &list) { submitCommandLists(&list, 1); }
 
 		ShaderProgram currentShader = {};
 		std::vector<ShaderProgram> shaderPushPop;
@@ -396,15 +575,13 @@ namespace gl2d
 		//clears the things that are to be drawn when calling flush
 		inline void clearDrawData()
 		{
-			spritePositions.clear();
-			spriteColors.clear();
-			texturePositions.clear();
+			spriteVertices.clear();
 			spriteTextures.clear();
-
-			//spritePositionsCount = 0;
-			//spriteColorsCount = 0;
-			//spriteTexturesCount = 0;
-			//texturePositionsCount = 0;
+			spriteSortKeys.clear();
+			renderStates.clear();
+			stateChanges.clear();
+			lastRenderState = 0;
+			culledQuads = 0;
 		}
 
 		glm::vec2 getTextSize(const char *text, const Font font, const float size = 1.5f,
@@ -510,6 +687,46 @@ namespace gl2d
 		void flushFBO(FrameBuffer frameBuffer, bool clearDrawData = true);
 	};
 
+	//Quads recorded away from the render thread: no gl calls and no shared state, so every worker
+	//thread can fill its own list in parallel. Vertices are in world space, the renderer camera is
+	//applied when the list is submitted with Renderer2D::submitCommandLists.
+	struct RenderCommandList
+	{
+		std::vector<Vertex2D> vertices; //4 per quad
+		std::vector<GLuint> textures; //1 per quad
+		std::vector<std::uint32_t> layerDepth; //1 per quad, layer << 16 | quantized depth
+
+		unsigned short currentLayer = 0;
+		float currentDepth = 0;
+		void setRenderLayer(unsigned short layer) { currentLayer = layer; }
+		void setRenderDepth(float depth) { currentDepth = depth; }
+
+		//copied from the renderer by begin
+		bool viewCulling = false;
+		glm::vec4 viewBounds = {};
+		size_t culledQuads = 0;
+
+		//Clears the list and takes the renderer view for culling.
+		//Call it before handing the list to a worker (it reads the renderer camera).
+		void begin(const Renderer2D &renderer);
+		void clear();
+
+		size_t quadCount() const { return textures.size(); }
+
+		//same as the Renderer2D functions, texture id 0 means untextured
+		void renderRectangle(const Rect transforms, GLuint texture, const Color4f colors[4], const glm::vec2 origin = {}, const float rotationDegrees = 0.f, const glm::vec4 textureCoords = GL2D_DefaultTextureCoords);
+		inline void renderRectangle(const Rect transforms, GLuint texture, const Color4f colors = {1,1,1,1}, const glm::vec2 origin = {}, const float rotationDegrees = 0.f, const glm::vec4 textureCoords = GL2D_DefaultTextureCoords)
+		{
+			Color4f c[4] = {colors,colors,colors,colors};
+			renderRectangle(transforms, texture, c, origin, rotationDegrees, textureCoords);
+		}
+
+		void renderQuads(const QuadDescriptor *quads, size_t count);
+
+		//scratch for culling in renderQuads
+		std::vector<QuadDescriptor> cullScratch;
+	};
+
 	void enableNecessaryGLFeatures();
 
 #pragma endregion
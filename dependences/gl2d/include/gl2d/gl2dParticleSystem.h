@@ -1,5 +1,6 @@
 #pragma once
 #include "gl2d.h"
+#include <memory>
 
 namespace gl2d
 {
@@ -11,6 +12,9 @@ namespace gl2d
 	
 	void cleanupgl2dParticleSystem();
 
+	//simd level the particle update picked at runtime: "scalar", "sse2", "avx2+fma" or "avx512"
+	const char *particleSimdLevel();
+
 	struct ParticleApearence
 	{
 		glm::vec2 size = {};
@@ -62,6 +66,42 @@ namespace gl2d
 	};
 
 
+	//xoshiro128+ with 8 independent lanes stepped side by side, so bulk fills vectorize.
+	//The same seed always gives the same numbers
+	struct ParticleRandom
+	{
+		ParticleRandom() { seed(std::random_device{}()); }
+
+		void seed(uint64_t seed);
+
+		//one number in [0, 1)
+		float next();
+
+		float uniform(float min, float max) { return min + next() * (max - min); }
+
+		//count numbers in [min, max)
+		void fillUniform(float *out, int count, float min, float max);
+
+	private:
+
+		static constexpr int LANES = 8;
+
+		uint32_t state[4][LANES] = {};
+		void step(uint32_t *out);
+
+		//what is left of the last step, handed out by next
+		uint32_t buffered[LANES] = {};
+		int bufferedCount = 0;
+	};
+
+	struct ParticleWorkers;
+
+	//ParticleWorkers is only complete in the cpp, the deleter is defined there
+	struct ParticleWorkersDeleter
+	{
+		void operator()(ParticleWorkers *w) const;
+	};
+
 	struct ParticleSystem
 	{
 		void initParticleSystem(int size);
@@ -77,10 +117,70 @@ namespace gl2d
 		bool postProcessing = true;
 		float pixelateFactor = 2;
 
+		//Draws straight from the particle streams: one instance per particle goes to a gpu buffer and
+		//the vertex shader does the transition curve, the size and color blend and the quad corners.
+		//The renderer is flushed first. Off goes through Renderer2D::renderQuads
+		bool instancedDraw = false;
+
+		//update threads including the calling one, 1 runs inline, 0 uses every hardware thread.
+		//The result is the same for any thread count
+		void setThreadCount(int threads);
+		int getThreadCount() { return threadCount; }
+
+		//fixes the random sequence so a run can be replayed
+		void setSeed(unsigned int seed) { random.seed(seed); }
+
 	private:
 
+		//stream length is a multiple of this (16 floats = one avx512 register = 64 bytes)
+		static constexpr int PARTICLE_PADDING = 16;
+
+		//every particle stream lives in this one block, each stream starts on a 64 byte boundary
+		char *arena = 0;
+		char *arenaAllocation = 0; //what was allocated, arena is aligned inside it
+		size_t arenaCapacity = 0; //in particles
+		void layoutArena(size_t capacity);
+
 		int size = 0;
 
+		//live particles are packed in [0, liveCount), dead ones are swap removed
+		int liveCount = 0;
+		void moveParticle(int from, int to);
+
+		//the update splits the live particles into chunks of this many,
+		//a multiple of PARTICLE_PADDING so every chunk starts on a cache line
+		static constexpr int PARTICLE_CHUNK = 4096;
+
+		//what a particle asked for during the update, applied after all chunks are done
+		struct ParticleEvent
+		{
+			int index;
+			bool died;
+		};
+
+		std::vector<std::vector<ParticleEvent>> chunkEvents;
+		std::vector<int> deadParticles;
+
+		int threadCount = 1;
+		//owning the pool makes ParticleSystem move only, a copy would share the threads
+		std::unique_ptr<ParticleWorkers, ParticleWorkersDeleter> workers;
+
+		void updateChunk(int chunk, float deltaTime);
+
+		//death rattles and sub emits are queued during the update and spawned together at the end of it
+		struct SpawnRequest
+		{
+			ParticleSettings *settings;
+			glm::vec2 pos;
+			int first = 0; //set by spawnQueued
+			int count = 0;
+		};
+
+		std::vector<SpawnRequest> spawnQueue;
+		std::vector<float> spawnScratch;
+		void spawnQueued();
+		void fillRandom(float *out, int count, glm::vec2 range);
+
 		float *posX = 0;
 		float *posY = 0;
 
@@ -111,10 +211,44 @@ namespace gl2d
 
 		gl2d::Texture **textures = 0;
 
-		std::mt19937 random{std::random_device{}()};
+		ParticleRandom random;
 
 		gl2d::FrameBuffer fb = {};
 
+		//particles are collected here and submitted with one Renderer2D::renderQuads call
+		std::vector<gl2d::QuadDescriptor> drawQuads;
+
+		//life of each particle after its tranzition curve, filled by evaluateTranzitions
+		std::vector<float> drawLife;
+		std::vector<int> tranzitionIndices; //live particles grouped by tranzition type
+		std::vector<float> tranzitionLife; //their life in the same order, what the kernels run on
+		void evaluateTranzitions();
+
+		//what the instanced draw writes per particle, 36 bytes
+		struct ParticleInstance
+		{
+			float x, y; //top left
+			float size, endSize;
+			float rotation; //degrees
+			float life; //duration / durationTotal, 1 when created
+			float tranzitionType;
+			uint32_t color, endColor; //rgba8
+		};
+
+		//consecutive instances with the same texture, one draw each
+		struct InstanceRun
+		{
+			GLuint texture;
+			int first;
+			int count;
+		};
+
+		GLuint instanceVao = 0;
+		gl2d::StreamBuffer instanceStream = {};
+		std::vector<InstanceRun> instanceRuns;
+
+		void drawInstanced(const gl2d::Camera &camera, glm::vec2 offset, float scale, int w, int h);
+
 		float rand(glm::vec2 v);
 	};
 
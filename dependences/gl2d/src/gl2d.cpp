@@ -67,6 +67,8 @@
 //
 
 #include <gl2d/gl2d.h>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -76,6 +78,19 @@
 #include <sstream>
 #include <algorithm>
 #include <iostream>
+#include <cstring>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <cassert>
+
+#if GL2D_SIMD != 0 && (defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__))
+#include <emmintrin.h>
+#define GL2D_SIMD_SSE2 1
+#else
+#define GL2D_SIMD_SSE2 0
+#endif
 
 //if you are not using visual studio make shure you link to "Opengl32.lib"
 #ifdef _MSC_VER
@@ -101,11 +116,12 @@ namespace gl2d
 		"in vec2 quad_positions;\n"
 		"in vec4 quad_colors;\n"
 		"in vec2 texturePositions;\n"
+		"uniform mat4 u_viewProjection;\n"
 		"out vec4 v_color;\n"
 		"out vec2 v_texture;\n"
 		"void main()\n"
 		"{\n"
-		"	gl_Position = vec4(quad_positions, 0, 1);\n"
+		"	gl_Position = u_viewProjection * vec4(quad_positions, 0, 1);\n"
 		"	v_color = quad_colors;\n"
 		"	v_texture = texturePositions;\n"
 		"}\n";
@@ -122,6 +138,54 @@ namespace gl2d
 		"    color = v_color * texture2D(u_sampler, v_texture);\n"
 		"}\n";
 
+	//used by the multi texture batching mode, the fragment shader is generated at init
+	//since glsl 330 can only index a sampler array with a constant
+	static ShaderProgram defaultMultiTextureShader = {};
+
+	static const char* defaultMultiTextureVertexShader =
+		GL2D_OPNEGL_SHADER_VERSION "\n"
+		GL2D_OPNEGL_SHADER_PRECISION "\n"
+		"in vec2 quad_positions;\n"
+		"in vec4 quad_colors;\n"
+		"in vec2 texturePositions;\n"
+		"in uint quad_textureIndex;\n"
+		"uniform mat4 u_viewProjection;\n"
+		"out vec4 v_color;\n"
+		"out vec2 v_texture;\n"
+		"flat out uint v_textureIndex;\n"
+		"void main()\n"
+		"{\n"
+		"	gl_Position = u_viewProjection * vec4(quad_positions, 0, 1);\n"
+		"	v_color = quad_colors;\n"
+		"	v_texture = texturePositions;\n"
+		"	v_textureIndex = quad_textureIndex;\n"
+		"}\n";
+
+	static std::string buildMultiTextureFragmentShader()
+	{
+		std::string s;
+		s += GL2D_OPNEGL_SHADER_VERSION "\n";
+		s += GL2D_OPNEGL_SHADER_PRECISION "\n";
+		s += "out vec4 color;\n";
+		s += "in vec4 v_color;\n";
+		s += "in vec2 v_texture;\n";
+		s += "flat in uint v_textureIndex;\n";
+		s += "uniform sampler2D u_samplers[" + std::to_string(GL2D_MAX_BATCH_TEXTURES) + "];\n";
+		s += "void main()\n";
+		s += "{\n";
+		s += "	vec4 t;\n";
+		for (int i = 0; i < GL2D_MAX_BATCH_TEXTURES - 1; i++)
+		{
+			s += "	" + std::string(i ? "else " : "") + "if (v_textureIndex == " + std::to_string(i) + "u) "
+				"t = texture(u_samplers[" + std::to_string(i) + "], v_texture);\n";
+		}
+		s += std::string("	") + (GL2D_MAX_BATCH_TEXTURES > 1 ? "else " : "") +
+			"t = texture(u_samplers[" + std::to_string(GL2D_MAX_BATCH_TEXTURES - 1) + "], v_texture);\n";
+		s += "	color = v_color * t;\n";
+		s += "}\n";
+		return s;
+	}
+
 #pragma endregion
 
 	static errorFuncType* errorFunc = defaultErrorFunc;
@@ -251,6 +315,20 @@ namespace gl2d
 	#endif
 
 		defaultShader = createShaderProgram(defaultVertexShader, defaultFragmentShader);
+
+		{
+			const std::string fragment = buildMultiTextureFragmentShader();
+			defaultMultiTextureShader = createShaderProgram(defaultMultiTextureVertexShader, fragment.c_str());
+
+			//sampler i reads unit i, this never changes so it is set once
+			GLint units[GL2D_MAX_BATCH_TEXTURES] = {};
+			for (int i = 0; i < GL2D_MAX_BATCH_TEXTURES; i++) { units[i] = i; }
+
+			glUseProgram(defaultMultiTextureShader.id);
+			glUniform1iv(glGetUniformLocation(defaultMultiTextureShader.id, "u_samplers"), GL2D_MAX_BATCH_TEXTURES, units);
+			glUseProgram(0);
+		}
+
 		white1pxSquareTexture.create1PxSquare();
 
 		enableNecessaryGLFeatures();
@@ -259,7 +337,8 @@ namespace gl2d
 	void clearnup()
 	{
 		white1pxSquareTexture.cleanup();
-		glDeleteShader(defaultShader.id);
+		glDeleteProgram(defaultShader.id);
+		glDeleteProgram(defaultMultiTextureShader.id);
 		hasInitialized = false;
 	}
 
@@ -318,6 +397,7 @@ namespace gl2d
 		glBindAttribLocation(shader.id, 0, "quad_positions");
 		glBindAttribLocation(shader.id, 1, "quad_colors");
 		glBindAttribLocation(shader.id, 2, "texturePositions");
+		glBindAttribLocation(shader.id, 3, "quad_textureIndex");
 
 		glLinkProgram(shader.id);
 
@@ -346,6 +426,7 @@ namespace gl2d
 		glValidateProgram(shader.id);
 
 		shader.u_sampler = glGetUniformLocation(shader.id, "u_sampler");
+		shader.u_viewProjection = glGetUniformLocation(shader.id, "u_viewProjection");
 
 		return shader;
 	}
@@ -401,101 +482,940 @@ namespace gl2d
 		unsigned char *fontMonochromeBuffer = new unsigned char[fontMonochromeBufferSize];
 		unsigned char *fontRgbaBuffer = new unsigned char[fontRgbaBufferSize];
 
-		packedCharsBuffer = new stbtt_packedchar[packedCharsBufferSize]{};
+		packedCharsBuffer = new stbtt_packedchar[packedCharsBufferSize]{};
+
+		stbtt_pack_context stbtt_context;
+		stbtt_PackBegin(&stbtt_context, fontMonochromeBuffer, size.x, size.y, 0, 2, NULL);
+		stbtt_PackSetOversampling(&stbtt_context, 2, 2);
+		stbtt_PackFontRange(&stbtt_context, ttf_data, 0, 65, ' ', '~' - ' ', packedCharsBuffer);
+		stbtt_PackEnd(&stbtt_context);
+
+		for (int i = 0; i < fontMonochromeBufferSize; i++)
+		{
+
+			fontRgbaBuffer[(i * 4)] = fontMonochromeBuffer[i];
+			fontRgbaBuffer[(i * 4) + 1] = fontMonochromeBuffer[i];
+			fontRgbaBuffer[(i * 4) + 2] = fontMonochromeBuffer[i];
+
+			if (fontMonochromeBuffer[i] > 1)
+			{
+				fontRgbaBuffer[(i * 4) + 3] = 255;
+			}
+			else
+			{
+				fontRgbaBuffer[(i * 4) + 3] = 0;
+			}
+		}
+
+		//Init texture
+		{
+			glGenTextures(1, &texture.id);
+			glBindTexture(GL_TEXTURE_2D, texture.id);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, fontRgbaBuffer);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+
+		delete[] fontMonochromeBuffer;
+		delete[] fontRgbaBuffer;
+
+		for (char c = ' '; c <= '~'; c++)
+		{
+			const stbtt_aligned_quad  q = internal::fontGetGlyphQuad(*this, c);
+			const float               m = q.y1 - q.y0;
+
+			if (m > max_height && m < 1.e+8f)
+			{
+				max_height = m;
+			}
+		}
+
+	}
+
+	void Font::createFromFile(const char *file)
+	{
+		std::ifstream fileFont(file, std::ios::binary);
+
+		if (!fileFont.is_open())
+		{
+			char c[300] = {0};
+			strcat(c, "error openning: ");
+			strcat(c + strlen(c), file);
+			errorFunc(c, userDefinedData);
+			return;
+		}
+
+		int fileSize = 0;
+		fileFont.seekg(0, std::ios::end);
+		fileSize = (int)fileFont.tellg();
+		fileFont.seekg(0, std::ios::beg);
+		unsigned char *fileData = new unsigned char[fileSize];
+		fileFont.read((char *)fileData, fileSize);
+		fileFont.close();
+
+		createFromTTF(fileData, fileSize);
+
+		delete[] fileData;
+	}
+
+	void Font::cleanup()
+	{
+		texture.cleanup();
+		*this = {};
+	}
+
+
+#pragma endregion
+
+	///////////////////// Camera /////////////////////
+#pragma region Camera
+
+#pragma endregion
+
+	///////////////////// StreamBuffer /////////////////////
+#pragma region StreamBuffer
+
+	static bool supportsBufferStorage()
+	{
+	#if GL2D_USE_PERSISTENT_MAPPING
+		return (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) && glBufferStorage != nullptr;
+	#else
+		return false;
+	#endif
+	}
+
+	void StreamBuffer::create(size_t bytesPerRegion, GLenum target)
+	{
+		cleanup();
+
+		this->target = target;
+		regionSize = std::max<size_t>(bytesPerRegion, 256);
+		allocateStorage();
+	}
+
+	void StreamBuffer::allocateStorage()
+	{
+		glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+
+		const size_t totalSize = regionSize * REGIONS;
+		persistent = supportsBufferStorage();
+
+		if (persistent)
+		{
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(target, totalSize, nullptr, flags);
+			persistentPtr = (char *)glMapBufferRange(target, 0, totalSize, flags);
+
+			if (!persistentPtr)
+			{
+				//can't map it, start over with a normal buffer
+				glDeleteBuffers(1, &buffer);
+				glGenBuffers(1, &buffer);
+				glBindBuffer(target, buffer);
+				persistent = false;
+			}
+		}
+
+		if (!persistent)
+		{
+			glBufferData(target, totalSize, nullptr, GL_STREAM_DRAW);
+		}
+
+		head = 0;
+		region = 0;
+	}
+
+	void StreamBuffer::cleanup()
+	{
+		for (auto &f : fences)
+		{
+			if (f) { glDeleteSync(f); }
+			f = 0;
+		}
+
+		if (buffer)
+		{
+			if (persistentPtr)
+			{
+				glBindBuffer(target, buffer);
+				glUnmapBuffer(target);
+			}
+			glDeleteBuffers(1, &buffer);
+		}
+
+		buffer = 0;
+		persistentPtr = 0;
+		persistent = false;
+		head = 0;
+		region = 0;
+	}
+
+	void StreamBuffer::waitRegion(int region)
+	{
+		GLsync &fence = fences[region];
+		if (!fence) { return; }
+
+		GLbitfield waitFlags = 0;
+		while (true)
+		{
+			const GLenum rez = glClientWaitSync(fence, waitFlags, 1'000'000); //1ms
+			if (rez == GL_ALREADY_SIGNALED || rez == GL_CONDITION_SATISFIED || rez == GL_WAIT_FAILED)
+			{
+				break;
+			}
+			waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		}
+
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	void StreamBuffer::grow(size_t minRegionSize)
+	{
+		size_t newSize = regionSize;
+		while (newSize < minRegionSize) { newSize *= 2; }
+
+		//the old buffer stays alive in the driver until the gpu is done with it
+		cleanup();
+		regionSize = newSize;
+		allocateStorage();
+	}
+
+	size_t StreamBuffer::alloc(size_t size)
+	{
+		//keep every allocation aligned for attribute offsets
+		size = (size + 15) & ~(size_t)15;
+
+		if (size > regionSize)
+		{
+			grow(size);
+		}
+
+		const size_t regionEnd = (region + 1) * regionSize;
+
+		if (head + size > regionEnd)
+		{
+			//everything that reads this region was already submitted
+			if (fences[region]) { glDeleteSync(fences[region]); }
+			fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			region = (region + 1) % REGIONS;
+			waitRegion(region);
+			head = region * regionSize;
+		}
+
+		assert(region >= 0 && region < REGIONS);
+		assert(head + size <= REGIONS * regionSize);
+
+		const size_t offset = head;
+		head += size;
+		return offset;
+	}
+
+	void *StreamBuffer::beginWrite(size_t size, size_t &outOffset)
+	{
+		outOffset = alloc(size);
+		glBindBuffer(target, buffer);
+
+		if (persistent)
+		{
+			return persistentPtr + outOffset;
+		}
+
+		return glMapBufferRange(target, outOffset, size,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	}
+
+	void StreamBuffer::endWrite()
+	{
+		if (!persistent)
+		{
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+		}
+	}
+
+	size_t StreamBuffer::upload(const void *data, size_t size)
+	{
+		size_t offset = 0;
+		void *dst = beginWrite(size, offset);
+		if (dst)
+		{
+			memcpy(dst, data, size);
+		}
+		endWrite();
+		return offset;
+	}
+
+#pragma endregion
+
+	///////////////////// Renderer2D /////////////////////
+#pragma region Renderer2D
+
+	//gpu side layouts of the compact vertex formats
+	struct Vertex2DRGBA8
+	{
+		glm::vec2 position;
+		std::uint32_t color;
+		glm::vec2 texturePosition;
+	};
+
+	struct Vertex2DRGBA8HalfUV
+	{
+		glm::vec2 position;
+		std::uint32_t color;
+		std::uint32_t texturePosition; //2 half floats
+	};
+
+	struct Vertex2DRGBA8NoUV
+	{
+		glm::vec2 position;
+		std::uint32_t color;
+	};
+
+	static_assert(sizeof(Vertex2D) == 32, "");
+	static_assert(sizeof(Vertex2DRGBA8) == 20, "");
+	static_assert(sizeof(Vertex2DRGBA8HalfUV) == 16, "");
+	static_assert(sizeof(Vertex2DRGBA8NoUV) == 12, "");
+
+	size_t vertexFormatStride(Renderer2DVertexFormat format)
+	{
+		switch (format)
+		{
+		case vertexFormatRGBA8: return sizeof(Vertex2DRGBA8);
+		case vertexFormatRGBA8HalfUV: return sizeof(Vertex2DRGBA8HalfUV);
+		case vertexFormatRGBA8NoUV: return sizeof(Vertex2DRGBA8NoUV);
+		default: return sizeof(Vertex2D);
+		}
+	}
+
+	//packUnorm4x8 puts x in the low byte so the bytes land in memory as r g b a
+	static void packVerticesRGBA8(Vertex2DRGBA8 *dst, const Vertex2D *src, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			dst[i].position = src[i].position;
+			dst[i].color = glm::packUnorm4x8(src[i].color);
+			dst[i].texturePosition = src[i].texturePosition;
+		}
+	}
+
+	static void packVerticesRGBA8HalfUV(Vertex2DRGBA8HalfUV *dst, const Vertex2D *src, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			dst[i].position = src[i].position;
+			dst[i].color = glm::packUnorm4x8(src[i].color);
+			dst[i].texturePosition = glm::packHalf2x16(src[i].texturePosition);
+		}
+	}
+
+	static void packVerticesRGBA8NoUV(Vertex2DRGBA8NoUV *dst, const Vertex2D *src, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			dst[i].position = src[i].position;
+			dst[i].color = glm::packUnorm4x8(src[i].color);
+		}
+	}
+
+	//Splits the quads [firstQuad, firstQuad + quadCount) in batches of at most GL2D_MAX_BATCH_TEXTURES
+	//distinct textures, in order (so blending stays correct) and writes the texture unit of every vertex.
+	//spriteTextureSlots must already be sized.
+	static void buildTextureBatches(Renderer2D &renderer, size_t firstQuad, size_t quadCount)
+	{
+		const size_t end = firstQuad + quadCount;
+
+		Renderer2D::TextureBatch batch;
+		batch.firstQuad = firstQuad;
+
+		for (size_t q = firstQuad; q < end; q++)
+		{
+			const GLuint id = renderer.spriteTextures[q];
+
+			int slot = -1;
+			for (int t = 0; t < batch.textureCount; t++)
+			{
+				if (batch.textures[t] == id) { slot = t; break; }
+			}
+
+			if (slot < 0)
+			{
+				if (batch.textureCount == GL2D_MAX_BATCH_TEXTURES)
+				{
+					batch.quadCount = q - batch.firstQuad;
+					renderer.textureBatches.push_back(batch);
+
+					batch = {};
+					batch.firstQuad = q;
+				}
+
+				slot = batch.textureCount++;
+				batch.textures[slot] = id;
+			}
+
+			memset(&renderer.spriteTextureSlots[q * 4], slot, 4);
+		}
+
+		batch.quadCount = end - batch.firstQuad;
+		renderer.textureBatches.push_back(batch);
+	}
+
+	//key layout, most significant first: layer 16 | render state 8 | texture 24 | depth 16
+	static std::uint16_t quantizeDepth(float depth)
+	{
+		return (std::uint16_t)(glm::clamp(depth, 0.f, 1.f) * 65535.f);
+	}
+
+	static std::uint64_t makeSortKey(unsigned short layer, unsigned int stateIndex, GLuint texture, std::uint16_t depth)
+	{
+		return ((std::uint64_t)layer << 48)
+			| ((std::uint64_t)(stateIndex & 0xFF) << 40)
+			| ((std::uint64_t)(texture & 0xFFFFFF) << 16)
+			| depth;
+	}
+
+	static unsigned int sortKeyStateIndex(std::uint64_t key)
+	{
+		return (unsigned int)((key >> 40) & 0xFF);
+	}
+
+	//Maps the gl2d world (pixels, y flipped like the vertices) to clip space. It is the same math the cpu
+	//used to do per vertex: camera translation, rotation and zoom around the window center, then to ndc.
+	static glm::mat4 cameraViewProjection(const Camera &camera, float w, float h)
+	{
+		const glm::vec3 center = {w / 2.f, -h / 2.f, 0};
+
+		glm::mat4 m = glm::translate(glm::mat4(1.f), glm::vec3(-1.f, 1.f, 0));
+		m = glm::scale(m, glm::vec3(2.f / w, 2.f / h, 1.f));
+		m = glm::translate(m, center);
+		m = glm::scale(m, glm::vec3(camera.zoom, camera.zoom, 1.f));
+		if (camera.rotation != 0)
+		{
+			m = glm::rotate(m, glm::radians(camera.rotation), glm::vec3(0, 0, 1));
+		}
+		m = glm::translate(m, -center);
+		m = glm::translate(m, glm::vec3(-camera.position.x, camera.position.y, 0));
+
+		return m;
+	}
+
+	//the clip space square brought back to vertex space, as an aabb (min x, min y, max x, max y)
+	static glm::vec4 cameraViewBounds(const Camera &camera, float w, float h)
+	{
+		if (w <= 0 || h <= 0 || camera.zoom == 0)
+		{
+			return {-INFINITY, -INFINITY, INFINITY, INFINITY};
+		}
+
+		const glm::mat4 inverse = glm::inverse(cameraViewProjection(camera, w, h));
+
+		glm::vec2 minP = glm::vec2(INFINITY);
+		glm::vec2 maxP = glm::vec2(-INFINITY);
+		const glm::vec2 corners[4] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+		for (const glm::vec2 &c : corners)
+		{
+			const glm::vec2 p = glm::vec2(inverse * glm::vec4(c, 0, 1));
+			minP = glm::min(minP, p);
+			maxP = glm::max(maxP, p);
+		}
+
+		return {minP.x, minP.y, maxP.x, maxP.y};
+	}
+
+	static bool outsideView(const glm::vec4 &view, float minX, float minY, float maxX, float maxY)
+	{
+		return maxX < view.x || maxY < view.y || minX > view.z || minY > view.w;
+	}
+
+	static bool quadOutsideView(const glm::vec4 &view, const Vertex2D quad[4])
+	{
+		const glm::vec2 minP = glm::min(glm::min(quad[0].position, quad[1].position), glm::min(quad[2].position, quad[3].position));
+		const glm::vec2 maxP = glm::max(glm::max(quad[0].position, quad[1].position), glm::max(quad[2].position, quad[3].position));
+
+		return outsideView(view, minP.x, minP.y, maxP.x, maxP.y);
+	}
+
+	//the 4 vertices of renderRectangleAbsRotation, in world space
+	static void buildRectangleQuad(Vertex2D out[4], const Rect transforms, const Color4f colors[4],
+		const glm::vec2 origin, const float rotation, const glm::vec4 textureCoords)
+	{
+		//We need to flip texture_transforms.y
+		const float transformsY = transforms.y * -1;
+
+		glm::vec2 v1 = { transforms.x,				  transformsY };
+		glm::vec2 v2 = { transforms.x,				  transformsY - transforms.w };
+		glm::vec2 v3 = { transforms.x + transforms.z, transformsY - transforms.w };
+		glm::vec2 v4 = { transforms.x + transforms.z, transformsY };
+
+		//Apply rotations
+		if (rotation != 0)
+		{
+			v1 = rotateAroundPoint(v1, origin, rotation);
+			v2 = rotateAroundPoint(v2, origin, rotation);
+			v3 = rotateAroundPoint(v3, origin, rotation);
+			v4 = rotateAroundPoint(v4, origin, rotation);
+		}
+
+		//the camera is applied by u_viewProjection at flush
+
+		//corners in the order the index buffer expects (0 1 3, 1 2 3)
+		const Vertex2D corners[4] =
+		{
+			{v1, colors[0], glm::vec2{ textureCoords.x, textureCoords.y }},
+			{v2, colors[1], glm::vec2{ textureCoords.x, textureCoords.w }},
+			{v3, colors[2], glm::vec2{ textureCoords.z, textureCoords.w }},
+			{v4, colors[3], glm::vec2{ textureCoords.z, textureCoords.y }},
+		};
+
+		memcpy(out, corners, sizeof(corners));
+	}
+
+	unsigned int Renderer2D::currentRenderState()
+	{
+		//the shader only matters for the sorted queue, else the flush shader is used
+		auto matches = [&](const RenderState &s)
+		{
+			return s.camera.position == currentCamera.position
+				&& s.camera.rotation == currentCamera.rotation
+				&& s.camera.zoom == currentCamera.zoom
+				&& s.windowW == windowW && s.windowH == windowH
+				&& (!sortedRendering || s.shader.id == currentShader.id);
+		};
+
+		//almost every quad uses the same state as the previous one
+		if (lastRenderState < renderStates.size() && matches(renderStates[lastRenderState]))
+		{
+			return lastRenderState;
+		}
+
+		for (size_t i = 0; i < renderStates.size(); i++)
+		{
+			if (matches(renderStates[i])) { return lastRenderState = (unsigned int)i; }
+		}
+
+		if (sortedRendering && renderStates.size() == 256)
+		{
+			errorFunc("Too many shader and camera combinations in one sorted flush (max 256)", userDefinedData);
+			return lastRenderState = 255;
+		}
+
+		RenderState state;
+		state.shader = currentShader;
+		state.camera = currentCamera;
+		state.windowW = windowW;
+		state.windowH = windowH;
+		state.viewBounds = cameraViewBounds(currentCamera, (float)windowW, (float)windowH);
+		renderStates.push_back(state);
+
+		return lastRenderState = (unsigned int)(renderStates.size() - 1);
+	}
+
+	void Renderer2D::submitQuad(const Vertex2D quad[4], GLuint texture)
+	{
+		const unsigned int state = currentRenderState();
+
+		if (viewCulling && quadOutsideView(renderStates[state].viewBounds, quad))
+		{
+			culledQuads++;
+			return;
+		}
+
+		if (sortedRendering)
+		{
+			spriteSortKeys.push_back(makeSortKey(currentLayer, state, texture, quantizeDepth(currentDepth)));
+		}
+		else if (stateChanges.empty() || stateChanges.back().state != state)
+		{
+			StateChange change;
+			change.firstQuad = spriteTextures.size();
+			change.state = state;
+			stateChanges.push_back(change);
+		}
+
+		spriteVertices.insert(spriteVertices.end(), quad, quad + 4);
+		spriteTextures.push_back(texture);
+	}
+
+	//the 4 corners of a quad rotated around its center, y flipped like renderRectangleAbsRotation does
+	//corner order matches the index buffer: top left, bottom left, bottom right, top right
+	static void writeQuadVertices(Vertex2D *out, const QuadDescriptor &q, float cx, float cy,
+		float ax, float ay, float bx, float by)
+	{
+		//a = rotated (-hx, hy), b = rotated (-hx, -hy), the other two corners are the opposites
+		const glm::vec4 &uv = q.textureCoords;
+
+		out[0] = {{cx + ax, cy + ay}, q.color, {uv.x, uv.y}};
+		out[1] = {{cx + bx, cy + by}, q.color, {uv.x, uv.w}};
+		out[2] = {{cx - ax, cy - ay}, q.color, {uv.z, uv.w}};
+		out[3] = {{cx - bx, cy - by}, q.color, {uv.z, uv.y}};
+	}
+
+#if GL2D_SIMD_SSE2
+
+	//cephes style sincos for 4 angles in radians, about 1e-7 error for the angles sprites use
+	static void sinCos4(__m128 x, __m128 &outSin, __m128 &outCos)
+	{
+		const __m128 twoOverPi = _mm_set1_ps(0.636619772367581f);
+
+		//quadrant and reduction to [-pi/4, pi/4] (pi/2 split in 3 parts to keep precision)
+		const __m128i j = _mm_cvtps_epi32(_mm_mul_ps(x, twoOverPi));
+		const __m128 jf = _mm_cvtepi32_ps(j);
+		__m128 y = _mm_sub_ps(x, _mm_mul_ps(jf, _mm_set1_ps(1.5703125f)));
+		y = _mm_sub_ps(y, _mm_mul_ps(jf, _mm_set1_ps(4.837512969970703125e-4f)));
+		y = _mm_sub_ps(y, _mm_mul_ps(jf, _mm_set1_ps(7.54978995489188216e-8f)));
+
+		const __m128 y2 = _mm_mul_ps(y, y);
+
+		__m128 s = _mm_set1_ps(-1.9515295891e-4f);
+		s = _mm_add_ps(_mm_mul_ps(s, y2), _mm_set1_ps(8.3321608736e-3f));
+		s = _mm_add_ps(_mm_mul_ps(s, y2), _mm_set1_ps(-1.6666654611e-1f));
+		s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, y2), y), y);
+
+		__m128 c = _mm_set1_ps(2.443315711809948e-5f);
+		c = _mm_add_ps(_mm_mul_ps(c, y2), _mm_set1_ps(-1.388731625493765e-3f));
+		c = _mm_add_ps(_mm_mul_ps(c, y2), _mm_set1_ps(4.166664568298827e-2f));
+		c = _mm_mul_ps(_mm_mul_ps(c, y2), y2);
+		c = _mm_add_ps(_mm_sub_ps(c, _mm_mul_ps(y2, _mm_set1_ps(0.5f))), _mm_set1_ps(1.f));
+
+		//odd quadrants swap sin and cos, quadrants 2 3 negate sin, quadrants 1 2 negate cos
+		const __m128i one = _mm_set1_epi32(1);
+		const __m128i two = _mm_set1_epi32(2);
+		const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, one), one));
+		const __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, two), 30));
+		const __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, one), two), 30));
+
+		const __m128 sinR = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+		const __m128 cosR = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+
+		outSin = _mm_xor_ps(sinR, sinSign);
+		outCos = _mm_xor_ps(cosR, cosSign);
+	}
+
+#endif
+
+	//Vertices of count quads (rotation around the center, one color), written to out (count * 4 vertices).
+	//No gl calls and no shared state so worker threads can use it.
+	static void generateQuadVertices(Vertex2D *out, const QuadDescriptor *quads, size_t count)
+	{
+		size_t i = 0;
+
+	#if GL2D_SIMD_SSE2
+		{
+			const __m128 degToRad = _mm_set1_ps(3.14159265358979f / 180.f);
+			const __m128 half = _mm_set1_ps(0.5f);
+
+			alignas(16) float ax[4], ay[4], bx[4], by[4], cx[4], cy[4];
+
+			for (; i + 4 <= count; i += 4)
+			{
+				const QuadDescriptor *q = quads + i;
+
+				const __m128 x = _mm_setr_ps(q[0].rect.x, q[1].rect.x, q[2].rect.x, q[3].rect.x);
+				const __m128 y = _mm_setr_ps(q[0].rect.y, q[1].rect.y, q[2].rect.y, q[3].rect.y);
+				const __m128 hx = _mm_mul_ps(_mm_setr_ps(q[0].rect.z, q[1].rect.z, q[2].rect.z, q[3].rect.z), half);
+				const __m128 hy = _mm_mul_ps(_mm_setr_ps(q[0].rect.w, q[1].rect.w, q[2].rect.w, q[3].rect.w), half);
+				const __m128 rotation = _mm_setr_ps(q[0].rotation, q[1].rotation, q[2].rotation, q[3].rotation);
+
+				__m128 sn, cs;
+				sinCos4(_mm_mul_ps(rotation, degToRad), sn, cs);
+
+				//center in the flipped space
+				_mm_store_ps(cx, _mm_add_ps(x, hx));
+				_mm_store_ps(cy, _mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(y, hy)));
+
+				//a = R * (-hx, hy), b = R * (-hx, -hy)
+				const __m128 hxC = _mm_mul_ps(hx, cs), hxS = _mm_mul_ps(hx, sn);
+				const __m128 hyC = _mm_mul_ps(hy, cs), hyS = _mm_mul_ps(hy, sn);
+				const __m128 zero = _mm_setzero_ps();
+
+				_mm_store_ps(ax, _mm_sub_ps(_mm_sub_ps(zero, hxC), hyS));
+				_mm_store_ps(ay, _mm_add_ps(_mm_sub_ps(zero, hxS), hyC));
+				_mm_store_ps(bx, _mm_add_ps(_mm_sub_ps(zero, hxC), hyS));
+				_mm_store_ps(by, _mm_sub_ps(_mm_sub_ps(zero, hxS), hyC));
+
+				for (int l = 0; l < 4; l++)
+				{
+					writeQuadVertices(out + (i + l) * 4, q[l], cx[l], cy[l], ax[l], ay[l], bx[l], by[l]);
+				}
+			}
+		}
+	#endif
+
+		for (; i < count; i++)
+		{
+			const QuadDescriptor &q = quads[i];
+			const float hx = q.rect.z * 0.5f;
+			const float hy = q.rect.w * 0.5f;
+
+			float sn = 0, cs = 1;
+			if (q.rotation != 0)
+			{
+				const float a = glm::radians(q.rotation);
+				sn = sinf(a);
+				cs = cosf(a);
+			}
+
+			writeQuadVertices(out + i * 4, q, q.rect.x + hx, -(q.rect.y + hy),
+				-hx * cs - hy * sn, -hx * sn + hy * cs,
+				-hx * cs + hy * sn, -hx * sn - hy * cs);
+		}
+	}
+
+	//keeps the quads whose bounding circle touches view (no trig needed), counts the others
+	static void cullQuadDescriptors(const glm::vec4 &view, const QuadDescriptor *quads, size_t count,
+		std::vector<QuadDescriptor> &out, size_t &culled)
+	{
+		out.clear();
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const QuadDescriptor &q = quads[i];
+			const float hx = q.rect.z * 0.5f;
+			const float hy = q.rect.w * 0.5f;
+			const float radius = std::sqrt(hx * hx + hy * hy);
+			const float cx = q.rect.x + hx;
+			const float cy = -(q.rect.y + hy);
+
+			if (outsideView(view, cx - radius, cy - radius, cx + radius, cy + radius))
+			{
+				culled++;
+			}
+			else
+			{
+				out.push_back(q);
+			}
+		}
+	}
+
+	void Renderer2D::renderQuads(const QuadDescriptor *quads, size_t count)
+	{
+		if (!count) { return; }
+
+		//one render state for the whole call
+		const unsigned int state = currentRenderState();
+
+		if (viewCulling)
+		{
+			cullQuadDescriptors(renderStates[state].viewBounds, quads, count, cullScratch, culledQuads);
+			quads = cullScratch.data();
+			count = cullScratch.size();
+			if (!count) { return; }
+		}
+
+		if (!sortedRendering && (stateChanges.empty() || stateChanges.back().state != state))
+		{
+			StateChange change;
+			change.firstQuad = spriteTextures.size();
+			change.state = state;
+			stateChanges.push_back(change);
+		}
 
-		stbtt_pack_context stbtt_context;
-		stbtt_PackBegin(&stbtt_context, fontMonochromeBuffer, size.x, size.y, 0, 2, NULL);
-		stbtt_PackSetOversampling(&stbtt_context, 2, 2);
-		stbtt_PackFontRange(&stbtt_context, ttf_data, 0, 65, ' ', '~' - ' ', packedCharsBuffer);
-		stbtt_PackEnd(&stbtt_context);
+		const size_t firstQuad = spriteTextures.size();
+		spriteTextures.resize(firstQuad + count);
+		spriteVertices.resize((firstQuad + count) * 4);
+		if (sortedRendering) { spriteSortKeys.reserve(firstQuad + count); }
 
-		for (int i = 0; i < fontMonochromeBufferSize; i++)
+		for (size_t i = 0; i < count; i++)
 		{
+			const GLuint texture = quads[i].texture ? quads[i].texture : white1pxSquareTexture.id;
+			spriteTextures[firstQuad + i] = texture;
 
-			fontRgbaBuffer[(i * 4)] = fontMonochromeBuffer[i];
-			fontRgbaBuffer[(i * 4) + 1] = fontMonochromeBuffer[i];
-			fontRgbaBuffer[(i * 4) + 2] = fontMonochromeBuffer[i];
-
-			if (fontMonochromeBuffer[i] > 1)
-			{
-				fontRgbaBuffer[(i * 4) + 3] = 255;
-			}
-			else
+			if (sortedRendering)
 			{
-				fontRgbaBuffer[(i * 4) + 3] = 0;
+				spriteSortKeys.push_back(makeSortKey(currentLayer, state, texture, quantizeDepth(currentDepth)));
 			}
 		}
 
-		//Init texture
+		generateQuadVertices(&spriteVertices[firstQuad * 4], quads, count);
+	}
+
+	void Renderer2D::submitCommandLists(const RenderCommandList *lists, size_t count)
+	{
+		size_t total = 0;
+		for (size_t l = 0; l < count; l++)
 		{
-			glGenTextures(1, &texture.id);
-			glBindTexture(GL_TEXTURE_2D, texture.id);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, fontRgbaBuffer);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			total += lists[l].quadCount();
+			culledQuads += lists[l].culledQuads;
+		}
 
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		if (!total) { return; }
+
+		const unsigned int state = currentRenderState();
+
+		if (!sortedRendering && (stateChanges.empty() || stateChanges.back().state != state))
+		{
+			StateChange change;
+			change.firstQuad = spriteTextures.size();
+			change.state = state;
+			stateChanges.push_back(change);
 		}
 
-		delete[] fontMonochromeBuffer;
-		delete[] fontRgbaBuffer;
+		//one resize, then every list is a plain copy
+		size_t quad = spriteTextures.size();
+		spriteTextures.resize(quad + total);
+		spriteVertices.resize((quad + total) * 4);
+		if (sortedRendering) { spriteSortKeys.reserve(quad + total); }
 
-		for (char c = ' '; c <= '~'; c++)
+		for (size_t l = 0; l < count; l++)
 		{
-			const stbtt_aligned_quad  q = internal::fontGetGlyphQuad(*this, c);
-			const float               m = q.y1 - q.y0;
+			const RenderCommandList &list = lists[l];
+			const size_t n = list.quadCount();
+			if (!n) { continue; }
 
-			if (m > max_height && m < 1.e+8f)
+			memcpy(&spriteVertices[quad * 4], list.vertices.data(), n * 4 * sizeof(Vertex2D));
+			memcpy(&spriteTextures[quad], list.textures.data(), n * sizeof(GLuint));
+
+			if (sortedRendering)
 			{
-				max_height = m;
+				for (size_t i = 0; i < n; i++)
+				{
+					const std::uint32_t ld = list.layerDepth[i];
+					spriteSortKeys.push_back(makeSortKey((unsigned short)(ld >> 16), state, list.textures[i], (std::uint16_t)(ld & 0xFFFF)));
+				}
 			}
+
+			quad += n;
 		}
+	}
+
+	void RenderCommandList::begin(const Renderer2D &renderer)
+	{
+		clear();
 
+		viewCulling = renderer.viewCulling;
+		viewBounds = cameraViewBounds(renderer.currentCamera, (float)renderer.windowW, (float)renderer.windowH);
 	}
 
-	void Font::createFromFile(const char *file)
+	void RenderCommandList::clear()
 	{
-		std::ifstream fileFont(file, std::ios::binary);
+		vertices.clear();
+		textures.clear();
+		layerDepth.clear();
+		culledQuads = 0;
+	}
 
-		if (!fileFont.is_open())
+	void RenderCommandList::renderRectangle(const Rect transforms, GLuint texture, const Color4f colors[4],
+		const glm::vec2 origin, const float rotation, const glm::vec4 textureCoords)
+	{
+		//same origin convention as Renderer2D::renderRectangle
+		const glm::vec2 center = {origin.x + transforms.x + transforms.z / 2, origin.y + transforms.y + transforms.w / 2};
+
+		Vertex2D quad[4];
+		buildRectangleQuad(quad, transforms, colors, center, rotation, textureCoords);
+
+		if (viewCulling && quadOutsideView(viewBounds, quad))
 		{
-			char c[300] = {0};
-			strcat(c, "error openning: ");
-			strcat(c + strlen(c), file);
-			errorFunc(c, userDefinedData);
+			culledQuads++;
 			return;
 		}
 
-		int fileSize = 0;
-		fileFont.seekg(0, std::ios::end);
-		fileSize = (int)fileFont.tellg();
-		fileFont.seekg(0, std::ios::beg);
-		unsigned char *fileData = new unsigned char[fileSize];
-		fileFont.read((char *)fileData, fileSize);
-		fileFont.close();
+		vertices.insert(vertices.end(), quad, quad + 4);
+		textures.push_back(texture ? texture : white1pxSquareTexture.id);
+		layerDepth.push_back(((std::uint32_t)currentLayer << 16) | quantizeDepth(currentDepth));
+	}
 
-		createFromTTF(fileData, fileSize);
+	void RenderCommandList::renderQuads(const QuadDescriptor *quads, size_t count)
+	{
+		if (viewCulling)
+		{
+			cullQuadDescriptors(viewBounds, quads, count, cullScratch, culledQuads);
+			quads = cullScratch.data();
+			count = cullScratch.size();
+		}
 
-		delete[] fileData;
+		if (!count) { return; }
+
+		const size_t firstQuad = textures.size();
+		textures.resize(firstQuad + count);
+		layerDepth.resize(firstQuad + count, ((std::uint32_t)currentLayer << 16) | quantizeDepth(currentDepth));
+		vertices.resize((firstQuad + count) * 4);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			textures[firstQuad + i] = quads[i].texture ? quads[i].texture : white1pxSquareTexture.id;
+		}
+
+		generateQuadVertices(&vertices[firstQuad * 4], quads, count);
 	}
 
-	void Font::cleanup()
+	//Stable LSD radix sort of the quads by key, 8 bits per pass, passes where every key
+	//has the same byte are skipped (most of the key is usually constant in a frame).
+	static void sortRenderQueue(Renderer2D &renderer)
 	{
-		texture.cleanup();
-		*this = {};
-	}
+		const size_t quads = renderer.spriteTextures.size();
 
+		std::vector<std::uint64_t> &keys = renderer.spriteSortKeys;
+		std::vector<std::uint64_t> &keysTmp = renderer.sortKeysScratch;
+		std::vector<std::uint32_t> &indices = renderer.sortIndices;
+		std::vector<std::uint32_t> &indicesTmp = renderer.sortIndicesScratch;
 
-#pragma endregion
+		keysTmp.resize(quads);
+		indices.resize(quads);
+		indicesTmp.resize(quads);
+		for (size_t i = 0; i < quads; i++) { indices[i] = (std::uint32_t)i; }
 
-	///////////////////// Camera /////////////////////
-#pragma region Camera
+		std::uint64_t differentBits = 0;
+		for (size_t i = 1; i < quads; i++) { differentBits |= keys[i] ^ keys[0]; }
 
-#pragma endregion
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			if (((differentBits >> shift) & 0xFF) == 0) { continue; }
 
-	///////////////////// Renderer2D /////////////////////
-#pragma region Renderer2D
+			size_t count[257] = {};
+			for (size_t i = 0; i < quads; i++) { count[((keys[i] >> shift) & 0xFF) + 1]++; }
+			for (int b = 0; b < 256; b++) { count[b + 1] += count[b]; }
+
+			for (size_t i = 0; i < quads; i++)
+			{
+				const size_t dst = count[(keys[i] >> shift) & 0xFF]++;
+				keysTmp[dst] = keys[i];
+				indicesTmp[dst] = indices[i];
+			}
+
+			keys.swap(keysTmp);
+			indices.swap(indicesTmp);
+		}
+
+		//apply the permutation to the quad data
+		std::vector<Vertex2D> &vertices = renderer.sortVerticesScratch;
+		std::vector<GLuint> &textures = renderer.sortTexturesScratch;
+		vertices.resize(quads * 4);
+		textures.resize(quads);
+
+		for (size_t i = 0; i < quads; i++)
+		{
+			const size_t from = indices[i];
+			memcpy(&vertices[i * 4], &renderer.spriteVertices[from * 4], sizeof(Vertex2D) * 4);
+			textures[i] = renderer.spriteTextures[from];
+		}
+
+		renderer.spriteVertices.swap(vertices);
+		renderer.spriteTextures.swap(textures);
+	}
+
+	//draws submission order needs: a new one for every shader, camera or texture change
+	static int countStateRuns(const Renderer2D &renderer)
+	{
+		const size_t quads = renderer.spriteTextures.size();
+		const bool hasKeys = renderer.spriteSortKeys.size() == quads;
+
+		int runs = quads ? 1 : 0;
+		for (size_t q = 1; q < quads; q++)
+		{
+			bool change = renderer.spriteTextures[q] != renderer.spriteTextures[q - 1];
+			if (hasKeys)
+			{
+				change = change || sortKeyStateIndex(renderer.spriteSortKeys[q]) != sortKeyStateIndex(renderer.spriteSortKeys[q - 1]);
+			}
+			runs += change;
+		}
+		return runs;
+	}
 
 	//won't bind any fbo
 	void internalFlush(gl2d::Renderer2D &renderer, bool clearDrawData)
@@ -534,8 +1454,17 @@ namespace gl2d
 			return;
 		}
 
+		//nothing left to draw (can happen when culling drops every quad), the frame still counts
 		if(renderer.spriteTextures.empty())
 		{
+			renderer.lastFlushStats = {};
+			renderer.lastFlushStats.culledQuads = renderer.culledQuads;
+
+			if (clearDrawData)
+			{
+				renderer.clearDrawData();
+			}
+
 			return;
 		}
 
@@ -543,44 +1472,235 @@ namespace gl2d
 
 		glBindVertexArray(renderer.vao);
 
-		glUseProgram(renderer.currentShader.id);
+		const size_t quads = renderer.spriteTextures.size();
+		Renderer2D::FlushStats &stats = renderer.lastFlushStats;
+		stats = {};
+		stats.quads = quads;
+		stats.culledQuads = renderer.culledQuads;
+
+		//split the quads in runs of the same shader and camera,
+		//with the render queue the key decides the shader of each quad
+		renderer.drawRuns.clear();
+		const bool sorted = renderer.sortedRendering && renderer.spriteSortKeys.size() == quads;
+
+		if (renderer.sortedRendering && !sorted)
+		{
+			errorFunc("Sorted rendering was toggled in the middle of a frame, drawing in submission order", userDefinedData);
+		}
+
+		auto addRun = [&](size_t first, size_t count, const ShaderProgram &shader, const Renderer2D::RenderState &state)
+		{
+			Renderer2D::DrawRun run;
+			run.firstQuad = first;
+			run.quadCount = count;
+			run.shader = shader;
+			run.viewProjection = cameraViewProjection(state.camera, (float)state.windowW, (float)state.windowH);
+			renderer.drawRuns.push_back(run);
+		};
+
+		if (sorted)
+		{
+			stats.batchesBeforeSort = countStateRuns(renderer);
+			sortRenderQueue(renderer);
+
+			size_t first = 0;
+			for (size_t q = 1; q <= quads; q++)
+			{
+				const unsigned int state = sortKeyStateIndex(renderer.spriteSortKeys[first]);
+				if (q == quads || sortKeyStateIndex(renderer.spriteSortKeys[q]) != state)
+				{
+					addRun(first, q - first, renderer.renderStates[state].shader, renderer.renderStates[state]);
+					first = q;
+				}
+			}
+		}
+		else if (renderer.stateChanges.empty() || renderer.stateChanges[0].firstQuad != 0)
+		{
+			//sorted rendering was turned off mid frame, use the current camera for everything
+			Renderer2D::RenderState state;
+			state.camera = renderer.currentCamera;
+			state.windowW = renderer.windowW;
+			state.windowH = renderer.windowH;
+			addRun(0, quads, renderer.currentShader, state);
+		}
+		else
+		{
+			const std::vector<Renderer2D::StateChange> &changes = renderer.stateChanges;
+			for (size_t i = 0; i < changes.size(); i++)
+			{
+				const size_t end = i + 1 < changes.size() ? changes[i + 1].firstQuad : quads;
+				if (end == changes[i].firstQuad) { continue; }
+				addRun(changes[i].firstQuad, end - changes[i].firstQuad, renderer.currentShader, renderer.renderStates[changes[i].state]);
+			}
+		}
+
+		//multi texture batching only works with the default shader
+		bool anyMultiTexture = false;
+		renderer.textureBatches.clear();
+		for (Renderer2D::DrawRun &run : renderer.drawRuns)
+		{
+			run.multiTexture = renderer.multiTextureBatching && run.shader.id == defaultShader.id;
+			if (run.multiTexture)
+			{
+				if (!anyMultiTexture) { renderer.spriteTextureSlots.resize(quads * 4); }
+				anyMultiTexture = true;
+
+				run.firstBatch = renderer.textureBatches.size();
+				buildTextureBatches(renderer, run.firstQuad, run.quadCount);
+				run.batchCount = renderer.textureBatches.size() - run.firstBatch;
+			}
+		}
+
+		//stream the vertex data, the offset changes every flush so the attributes are re-pointed
+		{
+			const size_t count = renderer.spriteVertices.size();
+			const Vertex2D *src = renderer.spriteVertices.data();
+			const GLsizei stride = (GLsizei)vertexFormatStride(renderer.vertexFormat);
+			const size_t verticesSize = count * stride;
+			const size_t slotsSize = anyMultiTexture ? count : 0;
+
+			//one allocation so a buffer grow can't leave some attributes pointing in the old buffer
+			size_t offset = 0;
+			char *dst = (char *)renderer.vertexStream.beginWrite(verticesSize + slotsSize, offset);
 
-		glUniform1i(renderer.currentShader.u_sampler, 0);
+			if (dst)
+			{
+				switch (renderer.vertexFormat)
+				{
+				case vertexFormatRGBA8: packVerticesRGBA8((Vertex2DRGBA8 *)dst, src, count); break;
+				case vertexFormatRGBA8HalfUV: packVerticesRGBA8HalfUV((Vertex2DRGBA8HalfUV *)dst, src, count); break;
+				case vertexFormatRGBA8NoUV: packVerticesRGBA8NoUV((Vertex2DRGBA8NoUV *)dst, src, count); break;
+				default: memcpy(dst, src, verticesSize); break;
+				}
+
+				//shaders without u_viewProjection get the camera applied here, position is first in every format
+				for (const Renderer2D::DrawRun &run : renderer.drawRuns)
+				{
+					if (run.multiTexture || run.shader.u_viewProjection >= 0) { continue; }
+
+					const size_t end = (run.firstQuad + run.quadCount) * 4;
+					for (size_t v = run.firstQuad * 4; v < end; v++)
+					{
+						const glm::vec4 p = run.viewProjection * glm::vec4(src[v].position, 0, 1);
+						memcpy(dst + v * stride, &p, sizeof(glm::vec2));
+					}
+				}
+
+				if (anyMultiTexture)
+				{
+					memcpy(dst + verticesSize, renderer.spriteTextureSlots.data(), slotsSize);
+				}
+			}
+			renderer.vertexStream.endWrite();
 
-		glBindBuffer(GL_ARRAY_BUFFER, renderer.buffers[Renderer2DBufferType::quadPositions]);
-		glBufferData(GL_ARRAY_BUFFER, renderer.spritePositions.size() * sizeof(glm::vec2), renderer.spritePositions.data(), GL_STREAM_DRAW);
+			switch (renderer.vertexFormat)
+			{
+			case vertexFormatRGBA8:
+				glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(Vertex2DRGBA8, position)));
+				glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)(offset + offsetof(Vertex2DRGBA8, color)));
+				glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(Vertex2DRGBA8, texturePosition)));
+				break;
+
+			case vertexFormatRGBA8HalfUV:
+				glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(Vertex2DRGBA8HalfUV, position)));
+				glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)(offset + offsetof(Vertex2DRGBA8HalfUV, color)));
+				glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(Vertex2DRGBA8HalfUV, texturePosition)));
+				break;
+
+			case vertexFormatRGBA8NoUV:
+				glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(Vertex2DRGBA8NoUV, position)));
+				glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)(offset + offsetof(Vertex2DRGBA8NoUV, color)));
+				//the texcoord array is off (see create), every vertex reads this constant, the context keeps it not the vao
+				glVertexAttrib2f(2, 0, 0);
+				break;
+
+			default:
+				glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(Vertex2D, position)));
+				glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(Vertex2D, color)));
+				glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *)(offset + offsetof(Vertex2D, texturePosition)));
+				break;
+			}
 
-		glBindBuffer(GL_ARRAY_BUFFER, renderer.buffers[Renderer2DBufferType::quadColors]);
-		glBufferData(GL_ARRAY_BUFFER, renderer.spriteColors.size() * sizeof(glm::vec4), renderer.spriteColors.data(), GL_STREAM_DRAW);
+			if (anyMultiTexture)
+			{
+				glEnableVertexAttribArray(3);
+				glVertexAttribIPointer(3, 1, GL_UNSIGNED_BYTE, 1, (void *)(offset + verticesSize));
+			}
+			else
+			{
+				glDisableVertexAttribArray(3);
+			}
+		}
 
-		glBindBuffer(GL_ARRAY_BUFFER, renderer.buffers[Renderer2DBufferType::texturePositions]);
-		glBufferData(GL_ARRAY_BUFFER, renderer.texturePositions.size() * sizeof(glm::vec2), renderer.texturePositions.data(), GL_STREAM_DRAW);
+		renderer.ensureQuadIndices(quads);
 
-		//Instance render the textures
+		for (const Renderer2D::DrawRun &run : renderer.drawRuns)
 		{
-			const int size = renderer.spriteTextures.size();
-			int pos = 0;
-			unsigned int id = renderer.spriteTextures[0].id;
+			if (run.multiTexture)
+			{
+				glUseProgram(defaultMultiTextureShader.id);
+				glUniformMatrix4fv(defaultMultiTextureShader.u_viewProjection, 1, GL_FALSE, &run.viewProjection[0][0]);
+
+				//one draw per group of GL2D_MAX_BATCH_TEXTURES distinct textures
+				for (size_t b = run.firstBatch; b < run.firstBatch + run.batchCount; b++)
+				{
+					const Renderer2D::TextureBatch &batch = renderer.textureBatches[b];
 
-			renderer.spriteTextures[0].bind();
+					for (int t = 0; t < batch.textureCount; t++)
+					{
+						glActiveTexture(GL_TEXTURE0 + t);
+						glBindTexture(GL_TEXTURE_2D, batch.textures[t]);
+					}
+
+					glDrawElements(GL_TRIANGLES, (GLsizei)(6 * batch.quadCount), GL_UNSIGNED_INT,
+						(void *)(batch.firstQuad * 6 * sizeof(GLuint)));
+					stats.drawCalls++;
+				}
 
-			for (int i = 1; i < size; i++)
+				glActiveTexture(GL_TEXTURE0);
+			}
+			else
 			{
-				if (renderer.spriteTextures[i].id != id)
+				glUseProgram(run.shader.id);
+				glUniform1i(run.shader.u_sampler, 0);
+				if (run.shader.u_viewProjection >= 0)
+				{
+					glUniformMatrix4fv(run.shader.u_viewProjection, 1, GL_FALSE, &run.viewProjection[0][0]);
+				}
+
+				//one draw per run of the same texture
+				const size_t end = run.firstQuad + run.quadCount;
+				size_t pos = run.firstQuad;
+				GLuint id = renderer.spriteTextures[pos];
+
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, id);
+
+				for (size_t i = pos + 1; i < end; i++)
 				{
-					glDrawArrays(GL_TRIANGLES, pos * 6, 6 * (i - pos));
+					if (renderer.spriteTextures[i] != id)
+					{
+						glDrawElements(GL_TRIANGLES, (GLsizei)(6 * (i - pos)), GL_UNSIGNED_INT, (void *)(pos * 6 * sizeof(GLuint)));
+						stats.drawCalls++;
 
-					pos = i;
-					id = renderer.spriteTextures[i].id;
+						pos = i;
+						id = renderer.spriteTextures[i];
+
+						glBindTexture(GL_TEXTURE_2D, id);
+					}
 
-					renderer.spriteTextures[i].bind();
 				}
 
+				glDrawElements(GL_TRIANGLES, (GLsizei)(6 * (end - pos)), GL_UNSIGNED_INT, (void *)(pos * 6 * sizeof(GLuint)));
+				stats.drawCalls++;
 			}
+		}
 
-			glDrawArrays(GL_TRIANGLES, pos * 6, 6 * (size - pos));
+		glBindVertexArray(0);
 
-			glBindVertexArray(0);
+		if (!sorted)
+		{
+			stats.batchesBeforeSort = stats.drawCalls;
 		}
 
 		if (clearDrawData) 
@@ -639,93 +1759,10 @@ namespace gl2d
 			textureCopy = white1pxSquareTexture;
 		}
 
-		//We need to flip texture_transforms.y
-		const float transformsY = transforms.y * -1;
-
-		glm::vec2 v1 = { transforms.x,				  transformsY };
-		glm::vec2 v2 = { transforms.x,				  transformsY - transforms.w };
-		glm::vec2 v3 = { transforms.x + transforms.z, transformsY - transforms.w };
-		glm::vec2 v4 = { transforms.x + transforms.z, transformsY };
-
-		//Apply rotations
-		if (rotation != 0)
-		{
-			v1 = rotateAroundPoint(v1, origin, rotation);
-			v2 = rotateAroundPoint(v2, origin, rotation);
-			v3 = rotateAroundPoint(v3, origin, rotation);
-			v4 = rotateAroundPoint(v4, origin, rotation);
-		}
-
-		//Apply camera transformations
-		v1.x -= currentCamera.position.x;
-		v1.y += currentCamera.position.y;
-		v2.x -= currentCamera.position.x;
-		v2.y += currentCamera.position.y;
-		v3.x -= currentCamera.position.x;
-		v3.y += currentCamera.position.y;
-		v4.x -= currentCamera.position.x;
-		v4.y += currentCamera.position.y;
-
-		//Apply camera rotation
-		if (currentCamera.rotation != 0)
-		{
-			glm::vec2 cameraCenter;
-
-			cameraCenter.x = windowW / 2.0f;
-			cameraCenter.y = windowH / 2.0f;
-
-			v1 = rotateAroundPoint(v1, cameraCenter, currentCamera.rotation);
-			v2 = rotateAroundPoint(v2, cameraCenter, currentCamera.rotation);
-			v3 = rotateAroundPoint(v3, cameraCenter, currentCamera.rotation);
-			v4 = rotateAroundPoint(v4, cameraCenter, currentCamera.rotation);
-		}
-
-		//Apply camera zoom
-		//if(renderer->currentCamera.zoom != 1)
-		{
-
-			glm::vec2 cameraCenter;
-			cameraCenter.x = windowW / 2.0f;
-			cameraCenter.y = -windowH / 2.0f;
-
-			v1 = scaleAroundPoint(v1, cameraCenter, currentCamera.zoom);
-			v2 = scaleAroundPoint(v2, cameraCenter, currentCamera.zoom);
-			v3 = scaleAroundPoint(v3, cameraCenter, currentCamera.zoom);
-			v4 = scaleAroundPoint(v4, cameraCenter, currentCamera.zoom);
-		}
-
-		v1.x = internal::positionToScreenCoordsX(v1.x, (float)windowW);
-		v2.x = internal::positionToScreenCoordsX(v2.x, (float)windowW);
-		v3.x = internal::positionToScreenCoordsX(v3.x, (float)windowW);
-		v4.x = internal::positionToScreenCoordsX(v4.x, (float)windowW);
-		v1.y = internal::positionToScreenCoordsY(v1.y, (float)windowH);
-		v2.y = internal::positionToScreenCoordsY(v2.y, (float)windowH);
-		v3.y = internal::positionToScreenCoordsY(v3.y, (float)windowH);
-		v4.y = internal::positionToScreenCoordsY(v4.y, (float)windowH);
-
-		spritePositions.push_back(glm::vec2{ v1.x, v1.y });
-		spritePositions.push_back(glm::vec2{ v2.x, v2.y });
-		spritePositions.push_back(glm::vec2{ v4.x, v4.y });
+		Vertex2D quad[4];
+		buildRectangleQuad(quad, transforms, colors, origin, rotation, textureCoords);
 
-		spritePositions.push_back(glm::vec2{ v2.x, v2.y });
-		spritePositions.push_back(glm::vec2{ v3.x, v3.y });
-		spritePositions.push_back(glm::vec2{ v4.x, v4.y });
-
-		spriteColors.push_back(colors[0]);
-		spriteColors.push_back(colors[1]);
-		spriteColors.push_back(colors[3]);
-		spriteColors.push_back(colors[1]);
-		spriteColors.push_back(colors[2]);
-		spriteColors.push_back(colors[3]);
-
-		texturePositions.push_back(glm::vec2{ textureCoords.x, textureCoords.y }); //1
-		texturePositions.push_back(glm::vec2{ textureCoords.x, textureCoords.w }); //2
-		texturePositions.push_back(glm::vec2{ textureCoords.z, textureCoords.y }); //4
-		texturePositions.push_back(glm::vec2{ textureCoords.x, textureCoords.w }); //2
-		texturePositions.push_back(glm::vec2{ textureCoords.z, textureCoords.w }); //3
-		texturePositions.push_back(glm::vec2{ textureCoords.z, textureCoords.y }); //4
-
-		spriteTextures.push_back(textureCopy);
+		submitQuad(quad, textureCopy.id);
 	}
 
 	void Renderer2D::renderRectangle(const Rect transforms, const Color4f colors[4], const glm::vec2 origin, const float rotation)
@@ -1132,7 +2169,7 @@ namespace gl2d
 
 	}
 
-	void Renderer2D::create(GLuint fbo, size_t quadCount)
+	void Renderer2D::create(GLuint fbo, size_t quadCount, Renderer2DVertexFormat vertexFormat)
 	{
 		if (!hasInitialized)
 		{
@@ -1140,11 +2177,10 @@ namespace gl2d
 		}
 
 		defaultFBO = fbo;
+		this->vertexFormat = vertexFormat;
 
 		clearDrawData();
-		spritePositions.reserve(quadCount * 6);
-		spriteColors.reserve(quadCount * 6);
-		texturePositions.reserve(quadCount * 6);
+		spriteVertices.reserve(quadCount * 4);
 		spriteTextures.reserve(quadCount);
 
 		this->resetCameraAndShader();
@@ -1152,27 +2188,57 @@ namespace gl2d
 		glGenVertexArrays(1, &vao);
 		glBindVertexArray(vao);
 
-		glGenBuffers(Renderer2DBufferType::bufferSize, buffers);
+		//one region holds about a frame worth of quads
+		vertexStream.create(quadCount * 4 * vertexFormatStride(vertexFormat));
 
-		glBindBuffer(GL_ARRAY_BUFFER, buffers[Renderer2DBufferType::quadPositions]);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		//the element buffer binding is part of the vao state
+		quadIndexBuffer = 0;
+		quadIndexCapacity = 0;
+		ensureQuadIndices(quadCount);
 
-		glBindBuffer(GL_ARRAY_BUFFER, buffers[Renderer2DBufferType::quadColors]);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexStream.buffer);
+		glEnableVertexAttribArray(0);
 		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-		glBindBuffer(GL_ARRAY_BUFFER, buffers[Renderer2DBufferType::texturePositions]);
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		if (vertexFormat != vertexFormatRGBA8NoUV)
+		{
+			glEnableVertexAttribArray(2);
+		}
 
 		glBindVertexArray(0);
 	}
 
+	//expects the renderer vao to be bound
+	void Renderer2D::ensureQuadIndices(size_t quadCount)
+	{
+		if (quadIndexBuffer && quadCount <= quadIndexCapacity) { return; }
+
+		size_t newCapacity = quadIndexCapacity ? quadIndexCapacity : 1;
+		while (newCapacity < quadCount) { newCapacity *= 2; }
+
+		std::vector<GLuint> indices;
+		indices.resize(newCapacity * 6);
+		for (size_t q = 0; q < newCapacity; q++)
+		{
+			const GLuint v = (GLuint)(q * 4);
+			GLuint *i = &indices[q * 6];
+			i[0] = v + 0; i[1] = v + 1; i[2] = v + 3;
+			i[3] = v + 1; i[4] = v + 2; i[5] = v + 3;
+		}
+
+		if (!quadIndexBuffer) { glGenBuffers(1, &quadIndexBuffer); }
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+		quadIndexCapacity = newCapacity;
+	}
+
 	void Renderer2D::cleanup()
 	{
 		glDeleteVertexArrays(1, &vao);
-		glDeleteBuffers(Renderer2DBufferType::bufferSize, buffers);
+		glDeleteBuffers(1, &quadIndexBuffer);
+		quadIndexBuffer = 0;
+		quadIndexCapacity = 0;
+		vertexStream.cleanup();
 	}
 
 	void Renderer2D::pushShader(ShaderProgram s)
@@ -2068,6 +3134,11 @@ namespace gl2d
 	//	return m; //todo not tested, add rotation
 	//}
 
+	glm::mat4 Camera::getViewProjection(float w, float h) const
+	{
+		return cameraViewProjection(*this, w, h);
+	}
+
 	void Camera::follow(glm::vec2 pos, float speed, float min, float max, float w, float h)
 	{
 		pos.x -= w / 2.f;
@@ -1,4 +1,14 @@
 #include <gl2d/gl2dParticleSystem.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+#include <cmath>
 
 namespace gl2d
 {
@@ -11,11 +21,12 @@ namespace gl2d
 		"in vec2 quad_positions;\n"
 		"in vec4 quad_colors;\n"
 		"in vec2 texturePositions;\n"
+		"uniform mat4 u_viewProjection;\n"
 		"out vec4 v_color;\n"
 		"out vec2 v_texture;\n"
 		"void main()\n"
 		"{\n"
-		"	gl_Position = vec4(quad_positions, 0, 1);\n"
+		"	gl_Position = u_viewProjection * vec4(quad_positions, 0, 1);\n"
 		"	v_color = quad_colors;\n"
 		"	v_texture = texturePositions;\n"
 		"}\n";
@@ -68,42 +79,93 @@ namespace gl2d
 			})";
 
 
-void ParticleSystem::initParticleSystem(int size)
-{
-	cleanup();
+	//instanced draw: 4 vertices per particle, the corner comes from gl_VertexID.
+	//The curves are the same as the ones draw uses on the cpu
+	static ShaderProgram instancedParticleShader = {};
+	static GLint instancedOffsetScale = -1;
+	static Texture particleWhiteTexture = {};
 
+	static const char *instancedParticleVertexShader =
+		GL2D_OPNEGL_SHADER_VERSION "\n"
+		GL2D_OPNEGL_SHADER_PRECISION "\n"
+		R"(layout(location = 0) in vec4 a_positionSize;
+			layout(location = 1) in vec3 a_rotationLifeTranzition;
+			layout(location = 2) in vec4 a_color;
+			layout(location = 3) in vec4 a_endColor;
+			uniform mat4 u_viewProjection;
+			uniform vec3 u_offsetScale;
+			out vec4 v_color;
+			out vec2 v_texture;
+
+			float tranzition(float t, int type)
+			{
+				const float pi = 3.141592;
+				if (type == 0) { return 1.0; }
+				if (type == 2) { return t * t; }
+				if (type == 3) { return t * t * t; }
+				if (type == 4) { return (cos(t * 5.0 * pi) * t + t) / 2.0; }
+				if (type == 5) { return cos(t * 5.0 * pi) * sqrt(t) * 0.9 + 0.1; }
+				if (type == 6) { return (cos(t * pi * 2.0) * sin(t * t)) / 2.0; }
+				if (type == 7) { return atan(2.0 * t * t * t * pi) / 2.0; }
+				return t;
+			}
 
-	//simdize size
-	size += 4 - (size % 4);
-	this->size = size;
+			void main()
+			{
+				float t = tranzition(a_rotationLifeTranzition.y, int(a_rotationLifeTranzition.z));
+
+				float size = mix(a_positionSize.w, a_positionSize.z, t) * u_offsetScale.z;
+				vec2 topLeft = (a_positionSize.xy + u_offsetScale.xy) * u_offsetScale.z;
+				vec2 center = vec2(topLeft.x + size * 0.5, -(topLeft.y + size * 0.5));
 
+				vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+				vec2 local = (corner - 0.5) * size;
 
-#pragma region allocations
+				float a = radians(a_rotationLifeTranzition.x);
+				float s = sin(a);
+				float c = cos(a);
+				local = vec2(local.x * c - local.y * s, local.x * s + local.y * c);
 
+				gl_Position = u_viewProjection * vec4(center + local, 0, 1);
+				v_color = mix(a_endColor, a_color, t);
+				v_texture = corner;
+			})";
 
-	int size32Aligned = size + (4 - (size % 4));
+	static const char *instancedParticleFragmentShader =
+		GL2D_OPNEGL_SHADER_VERSION "\n"
+		GL2D_OPNEGL_SHADER_PRECISION "\n"
+		"out vec4 color;\n"
+		"in vec4 v_color;\n"
+		"in vec2 v_texture;\n"
+		"uniform sampler2D u_sampler;\n"
+		"void main()\n"
+		"{\n"
+		"    color = v_color * texture(u_sampler, v_texture);\n"
+		"}\n";
 
-	posX = new float[size32Aligned];
-	posY = new float[size32Aligned];
-	directionX = new float[size32Aligned];
-	directionY = new float[size32Aligned];
-	rotation = new float[size32Aligned];
-	sizeXY = new float[size32Aligned];
-	dragX = new float[size32Aligned];
-	dragY = new float[size32Aligned];
-	duration = new float[size32Aligned];
-	durationTotal = new float[size32Aligned];
-	color = new glm::vec4[size];
-	rotationSpeed = new float[size32Aligned];
-	rotationDrag = new float[size32Aligned];
-	deathRattle = new ParticleSettings * [size32Aligned];
-	thisParticleSettings = new ParticleSettings * [size32Aligned];
-	emitParticle = new ParticleSettings * [size32Aligned];
-	tranzitionType = new char[size32Aligned];
-	textures = new gl2d::Texture * [size32Aligned];
-	emitTime = new float[size32Aligned];
 
-#pragma endregion
+void ParticleSystem::initParticleSystem(int size)
+{
+	//simdize size
+	size = (size + PARTICLE_PADDING - 1) / PARTICLE_PADDING * PARTICLE_PADDING;
+	if (size <= 0) { size = PARTICLE_PADDING; }
+	this->size = size;
+	liveCount = 0;
+
+	//reinitializing with a smaller or equal size reuses the arena
+	if ((size_t)size > arenaCapacity)
+	{
+		delete[] arenaAllocation;
+		arenaAllocation = 0;
+		arena = 0;
+		arenaCapacity = 0;
+
+		layoutArena(size);
+	}
+	else
+	{
+		layoutArena(arenaCapacity);
+	}
 
 	for (int i = 0; i < size; i++)
 	{
@@ -115,37 +177,812 @@ void ParticleSystem::initParticleSystem(int size)
 		emitParticle[i] = nullptr;
 	}
 
-	fb.create(100, 100);
+	if (!fb.fbo)
+	{
+		fb.create(100, 100);
+	}
+
+}
+
+//Points every stream inside the arena, allocating it first if needed.
+//Capacity is a multiple of PARTICLE_PADDING so every stream ends on a whole simd register.
+void ParticleSystem::layoutArena(size_t capacity)
+{
+	constexpr size_t ALIGNMENT = 64;
+
+	size_t offset = 0;
+	auto carve = [&](auto *&stream)
+	{
+		using T = std::remove_reference_t<decltype(*stream)>;
+		offset = (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+		stream = arena ? (T *)(arena + offset) : nullptr;
+		offset += sizeof(T) * capacity;
+	};
+
+	//with a null arena it only measures
+	auto carveAll = [&]()
+	{
+		offset = 0;
+		carve(posX);
+		carve(posY);
+		carve(directionX);
+		carve(directionY);
+		carve(rotation);
+		carve(sizeXY);
+		carve(dragX);
+		carve(dragY);
+		carve(duration);
+		carve(durationTotal);
+		carve(color);
+		carve(rotationSpeed);
+		carve(rotationDrag);
+		carve(emitTime);
+		carve(tranzitionType);
+		carve(deathRattle);
+		carve(thisParticleSettings);
+		carve(emitParticle);
+		carve(textures);
+	};
+
+	if (!arena)
+	{
+		carveAll();
 
+		//new throws on failure, a null malloc would leave every stream pointing near address 0
+		arenaAllocation = new char[offset + ALIGNMENT];
+		arena = (char *)(((uintptr_t)arenaAllocation + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1));
+		arenaCapacity = capacity;
+	}
+
+	carveAll();
 }
 
-#if GL2D_SIMD != 0
+#pragma region simd kernels
 
+//The update kernels are picked at runtime with cpuid, so one binary runs at full width on new cpus
+//and stays safe on old ones. Only x86 has simd variants, other platforms use the scalar loop.
+#if GL2D_SIMD != 0 && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define GL2D_PARTICLE_X86 1
+#include <immintrin.h>
 #if defined(_MSC_VER)
-/* Microsoft C/C++-compatible compiler */
 #include <intrin.h>
-#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
-/* GCC-compatible compiler, targeting x86/x86-64 */
-#include <x86intrin.h>
-#elif defined(__GNUC__) && defined(__ARM_NEON__)
-/* GCC-compatible compiler, targeting ARM with NEON */
-#include <arm_neon.h>
-#elif defined(__GNUC__) && defined(__IWMMXT__)
-/* GCC-compatible compiler, targeting ARM with WMMX */
-#include <mmintrin.h>
-#elif (defined(__GNUC__) || defined(__xlC__)) && (defined(__VEC__) || defined(__ALTIVEC__))
-/* XLC or GCC-compatible compiler, targeting PowerPC with VMX/VSX */
-#include <altivec.h>
-#elif defined(__GNUC__) && defined(__SPE__)
-/* GCC-compatible compiler, targeting PowerPC with SPE */
-#include <spe.h>
-#elif
-#undef GL2D_SIMD
-#define GL2D_SIMD 0
+#define GL2D_TARGET_AVX2
+#define GL2D_TARGET_AVX512
+#else
+#include <cpuid.h>
+#define GL2D_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define GL2D_TARGET_AVX512 __attribute__((target("avx512f")))
 #endif
+#else
+#define GL2D_PARTICLE_X86 0
+#endif
+
+namespace
+{
+	//dst[i] += t * src[i], count is a multiple of the widest register (PARTICLE_PADDING)
+	using AxpyKernel = void(*)(float *dst, const float *src, float t, int count);
+
+	void axpyScalar(float *dst, const float *src, float t, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			dst[i] += t * src[i];
+		}
+	}
+
+#if GL2D_PARTICLE_X86
+
+	//sse2 is baseline on x64, no fma here
+	void axpySSE2(float *dst, const float *src, float t, int count)
+	{
+		const __m128 _t = _mm_set1_ps(t);
+		for (int i = 0; i < count; i += 4)
+		{
+			__m128 d = _mm_load_ps(dst + i);
+			d = _mm_add_ps(d, _mm_mul_ps(_t, _mm_load_ps(src + i)));
+			_mm_store_ps(dst + i, d);
+		}
+	}
+
+	GL2D_TARGET_AVX2
+	void axpyAVX2(float *dst, const float *src, float t, int count)
+	{
+		const __m256 _t = _mm256_set1_ps(t);
+		for (int i = 0; i < count; i += 8)
+		{
+			const __m256 d = _mm256_fmadd_ps(_t, _mm256_load_ps(src + i), _mm256_load_ps(dst + i));
+			_mm256_store_ps(dst + i, d);
+		}
+	}
+
+	GL2D_TARGET_AVX512
+	void axpyAVX512(float *dst, const float *src, float t, int count)
+	{
+		const __m512 _t = _mm512_set1_ps(t);
+		for (int i = 0; i < count; i += 16)
+		{
+			const __m512 d = _mm512_fmadd_ps(_t, _mm512_load_ps(src + i), _mm512_load_ps(dst + i));
+			_mm512_store_ps(dst + i, d);
+		}
+	}
+
+	void cpuid(int leaf, int subleaf, unsigned int out[4])
+	{
+	#if defined(_MSC_VER)
+		int r[4] = {};
+		__cpuidex(r, leaf, subleaf);
+		for (int i = 0; i < 4; i++) { out[i] = (unsigned int)r[i]; }
+	#else
+		__cpuid_count(leaf, subleaf, out[0], out[1], out[2], out[3]);
+	#endif
+	}
+
+	//which register state the os saves on context switches
+	unsigned long long xgetbv0()
+	{
+	#if defined(_MSC_VER)
+		return _xgetbv(0);
+	#else
+		unsigned int lo = 0, hi = 0;
+		__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+		return ((unsigned long long)hi << 32) | lo;
+	#endif
+	}
 
 #endif
 
+	struct ParticleKernels
+	{
+		AxpyKernel axpy = axpyScalar;
+		const char *name = "scalar";
+	};
+
+	ParticleKernels detectParticleKernels()
+	{
+		ParticleKernels k;
+
+	#if GL2D_PARTICLE_X86
+		k.axpy = axpySSE2;
+		k.name = "sse2";
+
+		unsigned int r[4] = {};
+		cpuid(0, 0, r);
+		const unsigned int maxLeaf = r[0];
+
+		cpuid(1, 0, r);
+		const bool osxsave = (r[2] >> 27) & 1;
+		const bool fma = (r[2] >> 12) & 1;
+		if (!osxsave || maxLeaf < 7) { return k; }
+
+		const unsigned long long xcr0 = xgetbv0();
+		const bool osAvx = (xcr0 & 0x6) == 0x6; //xmm and ymm
+		const bool osAvx512 = (xcr0 & 0xE6) == 0xE6; //plus opmask and zmm
+
+		cpuid(7, 0, r);
+		const bool avx2 = (r[1] >> 5) & 1;
+		const bool avx512f = (r[1] >> 16) & 1;
+
+		if (avx512f && osAvx512)
+		{
+			k.axpy = axpyAVX512;
+			k.name = "avx512";
+		}
+		else if (avx2 && fma && osAvx)
+		{
+			k.axpy = axpyAVX2;
+			k.name = "avx2+fma";
+		}
+	#endif
+
+		return k;
+	}
+
+	const ParticleKernels &particleKernels()
+	{
+		static const ParticleKernels kernels = detectParticleKernels();
+		return kernels;
+	}
+}
+
+const char *particleSimdLevel()
+{
+	return particleKernels().name;
+}
+
+#pragma endregion
+
+#pragma region tranzition kernels
+
+//One kernel per TRANZITION_TYPES value and per instruction set, picked at compile time by the type
+//and at runtime by cpuid like the update kernels. They run on one contiguous bucket of life values.
+//The trig is polynomial: cos is a degree 14 taylor series on [-pi, pi], off by about 4e-6 at the ends
+namespace
+{
+	constexpr float PI = 3.14159265f;
+
+	constexpr int TRANZITION_TYPE_COUNT = TRANZITION_TYPES::delay2 + 1;
+
+	//applies the curve to life[0..count) in place
+	using TranzitionKernel = void(*)(float *life, int count);
+
+	//cos taylor terms in y^2, highest first
+	constexpr float COS_COEFFICIENTS[8] =
+	{
+		-1.f / 87178291200.f, 1.f / 479001600.f, -1.f / 3628800.f, 1.f / 40320.f,
+		-1.f / 720.f, 1.f / 24.f, -1.f / 2.f, 1.f,
+	};
+
+	//cephes atanf terms in z^2, highest first
+	constexpr float ATAN_COEFFICIENTS[4] =
+	{
+		8.05374449538e-2f, -1.38776856032e-1f, 1.99777106478e-1f, -3.33329491539e-1f,
+	};
+
+	//linear leaves the life as it is
+	void tranzitionIdentity(float *, int)
+	{
+	}
+
+#pragma region scalar
+
+	//cos on any range: reduced to [-pi, pi] then the even polynomial
+	inline float cosScalar(float x)
+	{
+		const float turns = x * (1.f / (2.f * PI));
+		const float y = (turns - std::floor(turns + 0.5f)) * (2.f * PI);
+		const float y2 = y * y;
+
+		float c = COS_COEFFICIENTS[0];
+		for (int k = 1; k < 8; k++) { c = c * y2 + COS_COEFFICIENTS[k]; }
+		return c;
+	}
+
+	inline float sinScalar(float x)
+	{
+		return cosScalar(x - PI / 2.f);
+	}
+
+	inline float atanScalar(float x)
+	{
+		const float ax = std::abs(x);
+
+		const bool big = ax > 2.414213562f;
+		const bool mid = ax > 0.414213562f;
+
+		const float z = big ? -1.f / ax : (mid ? (ax - 1.f) / (ax + 1.f) : ax);
+		const float offset = big ? PI / 2.f : (mid ? PI / 4.f : 0.f);
+
+		const float z2 = z * z;
+		float p = ATAN_COEFFICIENTS[0];
+		for (int k = 1; k < 4; k++) { p = p * z2 + ATAN_COEFFICIENTS[k]; }
+
+		const float r = offset + p * z2 * z + z;
+		return x < 0 ? -r : r;
+	}
+
+	template <int TYPE>
+	inline float tranzitionCurveScalar(float t)
+	{
+		if constexpr (TYPE == TRANZITION_TYPES::none) { return 1.f; }
+		else if constexpr (TYPE == TRANZITION_TYPES::curbe) { return t * t; }
+		else if constexpr (TYPE == TRANZITION_TYPES::abruptCurbe) { return t * t * t; }
+		else if constexpr (TYPE == TRANZITION_TYPES::wave) { return (cosScalar(t * 5 * PI) * t + t) / 2.f; }
+		else if constexpr (TYPE == TRANZITION_TYPES::wave2) { return cosScalar(t * 5 * PI) * std::sqrt(t) * 0.9f + 0.1f; }
+		else if constexpr (TYPE == TRANZITION_TYPES::delay) { return (cosScalar(t * PI * 2) * sinScalar(t * t)) / 2.f; }
+		else if constexpr (TYPE == TRANZITION_TYPES::delay2) { return atanScalar(2 * t * t * t * PI) / 2.f; }
+		else { return t; }
+	}
+
+	template <int TYPE>
+	void tranzitionScalar(float *life, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			life[i] = tranzitionCurveScalar<TYPE>(life[i]);
+		}
+	}
+
+	const TranzitionKernel tranzitionKernelsScalar[TRANZITION_TYPE_COUNT] =
+	{
+		tranzitionScalar<TRANZITION_TYPES::none>,
+		tranzitionIdentity,
+		tranzitionScalar<TRANZITION_TYPES::curbe>,
+		tranzitionScalar<TRANZITION_TYPES::abruptCurbe>,
+		tranzitionScalar<TRANZITION_TYPES::wave>,
+		tranzitionScalar<TRANZITION_TYPES::wave2>,
+		tranzitionScalar<TRANZITION_TYPES::delay>,
+		tranzitionScalar<TRANZITION_TYPES::delay2>,
+	};
+
+#pragma endregion
+
+#if GL2D_PARTICLE_X86
+
+#pragma region sse2
+
+	//sse2 has no floor, truncate and step down where that went up
+	inline __m128 floorSSE2(__m128 x)
+	{
+		const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+		return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.f)));
+	}
+
+	inline __m128 selectSSE2(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	inline __m128 cosSSE2(__m128 x)
+	{
+		const __m128 turns = _mm_mul_ps(x, _mm_set1_ps(1.f / (2.f * PI)));
+		const __m128 y = _mm_mul_ps(_mm_sub_ps(turns, floorSSE2(_mm_add_ps(turns, _mm_set1_ps(0.5f)))), _mm_set1_ps(2.f * PI));
+		const __m128 y2 = _mm_mul_ps(y, y);
+
+		__m128 c = _mm_set1_ps(COS_COEFFICIENTS[0]);
+		for (int k = 1; k < 8; k++) { c = _mm_add_ps(_mm_mul_ps(c, y2), _mm_set1_ps(COS_COEFFICIENTS[k])); }
+		return c;
+	}
+
+	inline __m128 sinSSE2(__m128 x)
+	{
+		return cosSSE2(_mm_sub_ps(x, _mm_set1_ps(PI / 2.f)));
+	}
+
+	inline __m128 atanSSE2(__m128 x)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.f);
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 ax = _mm_andnot_ps(signMask, x);
+
+		const __m128 big = _mm_cmpgt_ps(ax, _mm_set1_ps(2.414213562f));
+		const __m128 mid = _mm_cmpgt_ps(ax, _mm_set1_ps(0.414213562f));
+
+		__m128 z = selectSSE2(mid, _mm_div_ps(_mm_sub_ps(ax, one), _mm_add_ps(ax, one)), ax);
+		z = selectSSE2(big, _mm_div_ps(_mm_set1_ps(-1.f), ax), z);
+		__m128 offset = _mm_and_ps(mid, _mm_set1_ps(PI / 4.f));
+		offset = selectSSE2(big, _mm_set1_ps(PI / 2.f), offset);
+
+		const __m128 z2 = _mm_mul_ps(z, z);
+		__m128 p = _mm_set1_ps(ATAN_COEFFICIENTS[0]);
+		for (int k = 1; k < 4; k++) { p = _mm_add_ps(_mm_mul_ps(p, z2), _mm_set1_ps(ATAN_COEFFICIENTS[k])); }
+
+		const __m128 r = _mm_add_ps(_mm_add_ps(offset, _mm_mul_ps(_mm_mul_ps(p, z2), z)), z);
+		return _mm_or_ps(r, _mm_and_ps(x, signMask)); //r is positive, take the sign of x
+	}
+
+	template <int TYPE>
+	inline __m128 tranzitionCurveSSE2(__m128 t)
+	{
+		const __m128 half = _mm_set1_ps(0.5f);
+
+		if constexpr (TYPE == TRANZITION_TYPES::none) { return _mm_set1_ps(1.f); }
+		else if constexpr (TYPE == TRANZITION_TYPES::curbe) { return _mm_mul_ps(t, t); }
+		else if constexpr (TYPE == TRANZITION_TYPES::abruptCurbe) { return _mm_mul_ps(_mm_mul_ps(t, t), t); }
+		else if constexpr (TYPE == TRANZITION_TYPES::wave)
+		{
+			const __m128 c = cosSSE2(_mm_mul_ps(t, _mm_set1_ps(5 * PI)));
+			return _mm_mul_ps(_mm_add_ps(_mm_mul_ps(c, t), t), half);
+		}
+		else if constexpr (TYPE == TRANZITION_TYPES::wave2)
+		{
+			const __m128 c = cosSSE2(_mm_mul_ps(t, _mm_set1_ps(5 * PI)));
+			return _mm_add_ps(_mm_mul_ps(_mm_mul_ps(c, _mm_sqrt_ps(t)), _mm_set1_ps(0.9f)), _mm_set1_ps(0.1f));
+		}
+		else if constexpr (TYPE == TRANZITION_TYPES::delay)
+		{
+			const __m128 c = cosSSE2(_mm_mul_ps(t, _mm_set1_ps(PI * 2)));
+			return _mm_mul_ps(_mm_mul_ps(c, sinSSE2(_mm_mul_ps(t, t))), half);
+		}
+		else if constexpr (TYPE == TRANZITION_TYPES::delay2)
+		{
+			const __m128 t3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+			return _mm_mul_ps(atanSSE2(_mm_mul_ps(t3, _mm_set1_ps(2 * PI))), half);
+		}
+		else { return t; }
+	}
+
+	template <int TYPE>
+	void tranzitionSSE2(float *life, int count)
+	{
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_ps(life + i, tranzitionCurveSSE2<TYPE>(_mm_loadu_ps(life + i)));
+		}
+
+		//the tail goes through a padded register, the next bucket starts right after it
+		if (i < count)
+		{
+			float tail[4] = {};
+			std::copy(life + i, life + count, tail);
+			_mm_storeu_ps(tail, tranzitionCurveSSE2<TYPE>(_mm_loadu_ps(tail)));
+			std::copy(tail, tail + (count - i), life + i);
+		}
+	}
+
+	const TranzitionKernel tranzitionKernelsSSE2[TRANZITION_TYPE_COUNT] =
+	{
+		tranzitionSSE2<TRANZITION_TYPES::none>,
+		tranzitionIdentity,
+		tranzitionSSE2<TRANZITION_TYPES::curbe>,
+		tranzitionSSE2<TRANZITION_TYPES::abruptCurbe>,
+		tranzitionSSE2<TRANZITION_TYPES::wave>,
+		tranzitionSSE2<TRANZITION_TYPES::wave2>,
+		tranzitionSSE2<TRANZITION_TYPES::delay>,
+		tranzitionSSE2<TRANZITION_TYPES::delay2>,
+	};
+
+#pragma endregion
+
+#pragma region avx2
+
+	GL2D_TARGET_AVX2
+	inline __m256 cosAVX2(__m256 x)
+	{
+		const __m256 turns = _mm256_mul_ps(x, _mm256_set1_ps(1.f / (2.f * PI)));
+		const __m256 y = _mm256_mul_ps(_mm256_sub_ps(turns, _mm256_floor_ps(_mm256_add_ps(turns, _mm256_set1_ps(0.5f)))), _mm256_set1_ps(2.f * PI));
+		const __m256 y2 = _mm256_mul_ps(y, y);
+
+		__m256 c = _mm256_set1_ps(COS_COEFFICIENTS[0]);
+		for (int k = 1; k < 8; k++) { c = _mm256_fmadd_ps(c, y2, _mm256_set1_ps(COS_COEFFICIENTS[k])); }
+		return c;
+	}
+
+	GL2D_TARGET_AVX2
+	inline __m256 sinAVX2(__m256 x)
+	{
+		return cosAVX2(_mm256_sub_ps(x, _mm256_set1_ps(PI / 2.f)));
+	}
+
+	GL2D_TARGET_AVX2
+	inline __m256 atanAVX2(__m256 x)
+	{
+		const __m256 signMask = _mm256_set1_ps(-0.f);
+		const __m256 one = _mm256_set1_ps(1.f);
+		const __m256 ax = _mm256_andnot_ps(signMask, x);
+
+		const __m256 big = _mm256_cmp_ps(ax, _mm256_set1_ps(2.414213562f), _CMP_GT_OQ);
+		const __m256 mid = _mm256_cmp_ps(ax, _mm256_set1_ps(0.414213562f), _CMP_GT_OQ);
+
+		__m256 z = _mm256_blendv_ps(ax, _mm256_div_ps(_mm256_sub_ps(ax, one), _mm256_add_ps(ax, one)), mid);
+		z = _mm256_blendv_ps(z, _mm256_div_ps(_mm256_set1_ps(-1.f), ax), big);
+		__m256 offset = _mm256_and_ps(mid, _mm256_set1_ps(PI / 4.f));
+		offset = _mm256_blendv_ps(offset, _mm256_set1_ps(PI / 2.f), big);
+
+		const __m256 z2 = _mm256_mul_ps(z, z);
+		__m256 p = _mm256_set1_ps(ATAN_COEFFICIENTS[0]);
+		for (int k = 1; k < 4; k++) { p = _mm256_fmadd_ps(p, z2, _mm256_set1_ps(ATAN_COEFFICIENTS[k])); }
+
+		const __m256 r = _mm256_add_ps(_mm256_fmadd_ps(_mm256_mul_ps(p, z2), z, offset), z);
+		return _mm256_or_ps(r, _mm256_and_ps(x, signMask)); //r is positive, take the sign of x
+	}
+
+	template <int TYPE>
+	GL2D_TARGET_AVX2
+	inline __m256 tranzitionCurveAVX2(__m256 t)
+	{
+		const __m256 half = _mm256_set1_ps(0.5f);
+
+		if constexpr (TYPE == TRANZITION_TYPES::none) { return _mm256_set1_ps(1.f); }
+		else if constexpr (TYPE == TRANZITION_TYPES::curbe) { return _mm256_mul_ps(t, t); }
+		else if constexpr (TYPE == TRANZITION_TYPES::abruptCurbe) { return _mm256_mul_ps(_mm256_mul_ps(t, t), t); }
+		else if constexpr (TYPE == TRANZITION_TYPES::wave)
+		{
+			const __m256 c = cosAVX2(_mm256_mul_ps(t, _mm256_set1_ps(5 * PI)));
+			return _mm256_mul_ps(_mm256_fmadd_ps(c, t, t), half);
+		}
+		else if constexpr (TYPE == TRANZITION_TYPES::wave2)
+		{
+			const __m256 c = cosAVX2(_mm256_mul_ps(t, _mm256_set1_ps(5 * PI)));
+			return _mm256_fmadd_ps(_mm256_mul_ps(c, _mm256_sqrt_ps(t)), _mm256_set1_ps(0.9f), _mm256_set1_ps(0.1f));
+		}
+		else if constexpr (TYPE == TRANZITION_TYPES::delay)
+		{
+			const __m256 c = cosAVX2(_mm256_mul_ps(t, _mm256_set1_ps(PI * 2)));
+			return _mm256_mul_ps(_mm256_mul_ps(c, sinAVX2(_mm256_mul_ps(t, t))), half);
+		}
+		else if constexpr (TYPE == TRANZITION_TYPES::delay2)
+		{
+			const __m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+			return _mm256_mul_ps(atanAVX2(_mm256_mul_ps(t3, _mm256_set1_ps(2 * PI))), half);
+		}
+		else { return t; }
+	}
+
+	template <int TYPE>
+	GL2D_TARGET_AVX2
+	void tranzitionAVX2(float *life, int count)
+	{
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm256_storeu_ps(life + i, tranzitionCurveAVX2<TYPE>(_mm256_loadu_ps(life + i)));
+		}
+
+		//the tail goes through a padded register, the next bucket starts right after it
+		if (i < count)
+		{
+			float tail[8] = {};
+			std::copy(life + i, life + count, tail);
+			_mm256_storeu_ps(tail, tranzitionCurveAVX2<TYPE>(_mm256_loadu_ps(tail)));
+			std::copy(tail, tail + (count - i), life + i);
+		}
+	}
+
+	const TranzitionKernel tranzitionKernelsAVX2[TRANZITION_TYPE_COUNT] =
+	{
+		tranzitionAVX2<TRANZITION_TYPES::none>,
+		tranzitionIdentity,
+		tranzitionAVX2<TRANZITION_TYPES::curbe>,
+		tranzitionAVX2<TRANZITION_TYPES::abruptCurbe>,
+		tranzitionAVX2<TRANZITION_TYPES::wave>,
+		tranzitionAVX2<TRANZITION_TYPES::wave2>,
+		tranzitionAVX2<TRANZITION_TYPES::delay>,
+		tranzitionAVX2<TRANZITION_TYPES::delay2>,
+	};
+
+#pragma endregion
+
+#endif
+
+	//same cpuid checks as detectParticleKernels, avx512 cpus use the avx2 curves
+	const TranzitionKernel *detectTranzitionKernels()
+	{
+	#if GL2D_PARTICLE_X86
+		unsigned int r[4] = {};
+		cpuid(0, 0, r);
+		const unsigned int maxLeaf = r[0];
+
+		cpuid(1, 0, r);
+		const bool osxsave = (r[2] >> 27) & 1;
+		const bool fma = (r[2] >> 12) & 1;
+		if (!osxsave || maxLeaf < 7) { return tranzitionKernelsSSE2; }
+
+		const bool osAvx = (xgetbv0() & 0x6) == 0x6;
+
+		cpuid(7, 0, r);
+		const bool avx2 = (r[1] >> 5) & 1;
+
+		if (avx2 && fma && osAvx)
+		{
+			return tranzitionKernelsAVX2;
+		}
+
+		return tranzitionKernelsSSE2;
+	#else
+		return tranzitionKernelsScalar;
+	#endif
+	}
+
+	const TranzitionKernel *tranzitionKernels()
+	{
+		static const TranzitionKernel *kernels = detectTranzitionKernels();
+		return kernels;
+	}
+}
+
+//Fills drawLife with the curved life of every live particle. The life values are grouped by
+//tranzition type with a counting pass into tranzitionLife, each bucket goes through its kernel
+//and the results are put back in particle order. Unknown types count as linear like they always did
+void ParticleSystem::evaluateTranzitions()
+{
+	drawLife.resize(liveCount);
+	tranzitionLife.resize(liveCount);
+	tranzitionIndices.resize(liveCount);
+
+	for (int i = 0; i < liveCount; i++)
+	{
+		drawLife[i] = duration[i] / durationTotal[i]; //close to 0 when gone, 1 when full
+	}
+
+	auto bucket = [&](int i)
+	{
+		const int type = tranzitionType[i];
+		return (type >= 0 && type < TRANZITION_TYPE_COUNT) ? type : (int)TRANZITION_TYPES::linear;
+	};
+
+	int bucketStart[TRANZITION_TYPE_COUNT + 1] = {};
+	for (int i = 0; i < liveCount; i++)
+	{
+		bucketStart[bucket(i) + 1]++;
+	}
+
+	for (int t = 0; t < TRANZITION_TYPE_COUNT; t++)
+	{
+		bucketStart[t + 1] += bucketStart[t];
+	}
+
+	int bucketEnd[TRANZITION_TYPE_COUNT];
+	std::copy(bucketStart, bucketStart + TRANZITION_TYPE_COUNT, bucketEnd);
+	for (int i = 0; i < liveCount; i++)
+	{
+		const int slot = bucketEnd[bucket(i)]++;
+		tranzitionIndices[slot] = i;
+		tranzitionLife[slot] = drawLife[i];
+	}
+
+	const TranzitionKernel *kernels = tranzitionKernels();
+	for (int t = 0; t < TRANZITION_TYPE_COUNT; t++)
+	{
+		kernels[t](tranzitionLife.data() + bucketStart[t], bucketStart[t + 1] - bucketStart[t]);
+	}
+
+	for (int slot = 0; slot < liveCount; slot++)
+	{
+		drawLife[tranzitionIndices[slot]] = tranzitionLife[slot];
+	}
+}
+
+#pragma endregion
+
+#pragma region update workers
+
+//Persistent threads for the particle update. run hands out job indexes until they are all taken,
+//the calling thread works too and it returns once every job is finished.
+struct ParticleWorkers
+{
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	//a plain function and its context, so handing out a job is one indirect call and nothing is allocated
+	void (*job)(void *context, int index) = 0;
+	void *context = 0;
+	std::atomic<int> nextJob{0};
+	int jobCount = 0;
+	int generation = 0;
+	int busy = 0;
+	bool quit = false;
+
+	ParticleWorkers(int count)
+	{
+		for (int i = 1; i < count; i++)
+		{
+			threads.emplace_back([this]() { loop(); });
+		}
+	}
+
+	~ParticleWorkers()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+
+		for (auto &t : threads)
+		{
+			t.join();
+		}
+	}
+
+	void work()
+	{
+		for (int j = nextJob++; j < jobCount; j = nextJob++)
+		{
+			job(context, j);
+		}
+	}
+
+	void loop()
+	{
+		int seen = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&]() { return quit || generation != seen; });
+				if (quit) { return; }
+				seen = generation;
+			}
+
+			work();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--busy == 0) { done.notify_one(); }
+			}
+		}
+	}
+
+	void run(int count, void (*f)(void *context, int index), void *c)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = f;
+			context = c;
+			jobCount = count;
+			nextJob = 0;
+			busy = (int)threads.size();
+			generation++;
+		}
+		wake.notify_all();
+
+		work();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&]() { return busy == 0; });
+	}
+};
+
+void ParticleSystem::setThreadCount(int threads)
+{
+	if (threads <= 0)
+	{
+		threads = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+
+	if (threads == threadCount) { return; }
+	threadCount = threads;
+
+	workers.reset();
+
+	if (threadCount > 1)
+	{
+		workers.reset(new ParticleWorkers(threadCount));
+	}
+}
+
+void ParticleWorkersDeleter::operator()(ParticleWorkers *w) const
+{
+	delete w;
+}
+
+#pragma endregion
+
+//Counts down and moves the particles of one chunk. It only touches its own slots,
+//deaths and sub emits are recorded in chunkEvents for applyMovement to apply in chunk order
+void ParticleSystem::updateChunk(int chunk, float deltaTime)
+{
+	const int begin = chunk * PARTICLE_CHUNK;
+	const int end = std::min(begin + PARTICLE_CHUNK, liveCount);
+
+	auto &events = chunkEvents[chunk];
+	events.clear();
+
+	for (int i = begin; i < end; i++)
+	{
+
+		if (duration[i] > 0)
+			duration[i] -= deltaTime;
+
+		if (emitTime[i] > 0 && emitParticle[i])
+			emitTime[i] -= deltaTime;
+
+		if (duration[i] <= 0)
+		{
+			events.push_back({i, true});
+		}
+		else if (emitTime[i] <= 0 && emitParticle[i])
+		{
+			events.push_back({i, false});
+		}
+
+	}
+
+	//the kernels go over whole registers, the streams are padded to the widest one
+	const int updateCount = (end - begin + PARTICLE_PADDING - 1) / PARTICLE_PADDING * PARTICLE_PADDING;
+	const AxpyKernel axpy = particleKernels().axpy;
+
+#pragma region applyDrag
+
+	axpy(directionX + begin, dragX + begin, deltaTime, updateCount);
+	axpy(directionY + begin, dragY + begin, deltaTime, updateCount);
+	axpy(rotationSpeed + begin, rotationDrag + begin, deltaTime, updateCount);
+
+#pragma endregion
+
+#pragma region apply movement
+
+	axpy(posX + begin, directionX + begin, deltaTime, updateCount);
+	axpy(posY + begin, directionY + begin, deltaTime, updateCount);
+	axpy(rotation + begin, rotationSpeed + begin, deltaTime, updateCount);
+
+#pragma endregion
+
+}
+
 void ParticleSystem::applyMovement(float deltaTime)
 {
 
@@ -191,190 +1028,82 @@ void ParticleSystem::applyMovement(float deltaTime)
 #pragma endregion
 
 
-	for (int i = 0; i < size; i++)
-	{
-
-		if (duration[i] > 0)
-			duration[i] -= deltaTime;
-
-		if (emitTime[i] > 0 && emitParticle[i])
-			emitTime[i] -= deltaTime;
-
-		if (duration[i] <= 0)
-		{
-			if (deathRattle[i] != nullptr && deathRattle[i]->onCreateCount)
-			{
-
-				this->emitParticleWave(deathRattle[i], {posX[i], posY[i]});
-
-			}
-
-			deathRattle[i] = nullptr;
-			duration[i] = 0;
-			sizeXY[i] = 0;
-			emitParticle[i] = nullptr;
-
-		}
-		else if (emitTime[i] <= 0 && emitParticle[i])
-		{
-			emitTime[i] = rand(thisParticleSettings[i]->subemitParticleTime);
-
-			//emit particle
-			this->emitParticleWave(emitParticle[i], {posX[i], posY[i]});
-
-		}
-
-	}
-
-	__m128 _deltaTime = _mm_set1_ps(deltaTime);
-
-#pragma region applyDrag
-
-#if GL2D_SIMD == 0
-	for (int i = 0; i < size; i++)
-	{
-		//if (duration[i] > 0)
-		directionX[i] += deltaTime * dragX[i];
-	}
-
-	for (int i = 0; i < size; i++)
-	{
-		//if (duration[i] > 0)
-		directionY[i] += deltaTime * dragY[i];
-
-	}
-
-	for (int i = 0; i < size; i++)
-	{
-
-		//if (duration[i] > 0)
-		rotationSpeed[i] += deltaTime * rotationDrag[i];
-	}
-#else
-
-	for (int i = 0; i < size; i += 4)
-	{
-		//directionX[i] += deltaTime * dragX[i];
-
-		__m128 *dir = (__m128 *) & (directionX[i]);
-		__m128 *drag = (__m128 *) & (dragX[i]);
-
-		*dir = _mm_fmadd_ps(_deltaTime, *drag, *dir);
-	}
-
-	for (int i = 0; i < size; i += 4)
-	{
-		//directionY[i] += deltaTime * dragY[i];
-
-		__m128 *dir = (__m128 *) & (directionY[i]);
-		__m128 *drag = (__m128 *) & (dragY[i]);
-
-		*dir = _mm_fmadd_ps(_deltaTime, *drag, *dir);
-	}
-
-	for (int i = 0; i < size; i += 4)
+	//chunks only depend on the particle count so the same events come out in the same order
+	//for any thread count, and only this thread touches the random generator
+	const int chunks = (liveCount + PARTICLE_CHUNK - 1) / PARTICLE_CHUNK;
+	if (chunkEvents.size() < (size_t)chunks)
 	{
-		//rotationSpeed[i] += deltaTime * rotationDrag[i];
-
-		__m128 *dir = (__m128 *) & (rotationSpeed[i]);
-		__m128 *drag = (__m128 *) & (rotationDrag[i]);
-
-		*dir = _mm_fmadd_ps(_deltaTime, *drag, *dir);
+		chunkEvents.resize(chunks);
 	}
-#endif
-
-
-
-#pragma endregion
-
-
-#pragma region apply movement
 
-
-#if GL2D_SIMD == 0
-	for (int i = 0; i < size; i++)
+	if (workers && chunks > 1)
 	{
-		//if (duration[i] > 0)
-		posX[i] += deltaTime * directionX[i];
+		struct ChunkJob
+		{
+			ParticleSystem *system;
+			float deltaTime;
+		} chunkJob = {this, deltaTime};
 
+		workers->run(chunks, [](void *context, int chunk)
+		{
+			auto *j = (ChunkJob *)context;
+			j->system->updateChunk(chunk, j->deltaTime);
+		}, &chunkJob);
 	}
-
-
-	for (int i = 0; i < size; i++)
+	else
 	{
-		//if (duration[i] > 0)
-		posY[i] += deltaTime * directionY[i];
-
+		for (int c = 0; c < chunks; c++)
+		{
+			updateChunk(c, deltaTime);
+		}
 	}
 
-	for (int i = 0; i < size; i++)
-	{
-		//if (duration[i] > 0)
-		rotation[i] += deltaTime * rotationSpeed[i];
-
-	}
-#else 
-	for (int i = 0; i < size; i += 4)
+	//spawns are only queued here, the pool is not touched until every event is read
+	deadParticles.clear();
+	for (int c = 0; c < chunks; c++)
 	{
-		//posX[i] += deltaTime * directionX[i];
-		__m128 *dir = (__m128 *) & (posX[i]);
-		__m128 *drag = (__m128 *) & (directionX[i]);
-
-		*dir = _mm_fmadd_ps(_deltaTime, *drag, *dir);
-	}
+		for (auto &e : chunkEvents[c])
+		{
+			const int i = e.index;
 
+			if (e.died)
+			{
+				if (deathRattle[i] != nullptr && deathRattle[i]->onCreateCount)
+				{
+					spawnQueue.push_back({deathRattle[i], {posX[i], posY[i]}});
+				}
 
-	for (int i = 0; i < size; i++)
-	{
-		//posY[i] += deltaTime * directionY[i];
-		__m128 *dir = (__m128 *) & (posY[i]);
-		__m128 *drag = (__m128 *) & (directionY[i]);
+				deadParticles.push_back(i);
+			}
+			else
+			{
+				emitTime[i] = rand(thisParticleSettings[i]->subemitParticleTime);
 
-		*dir = _mm_fmadd_ps(_deltaTime, *drag, *dir);
+				//emit particle
+				spawnQueue.push_back({emitParticle[i], {posX[i], posY[i]}});
+			}
+		}
 	}
 
-	for (int i = 0; i < size; i++)
+	//swap remove from the back, every dead slot above the current one is already gone
+	//so the last particle is always a live one
+	for (int d = (int)deadParticles.size() - 1; d >= 0; d--)
 	{
-		//rotation[i] += deltaTime * rotationSpeed[i];
-		__m128 *dir = (__m128 *) & (rotation[i]);
-		__m128 *drag = (__m128 *) & (rotationSpeed[i]);
-
-		*dir = _mm_fmadd_ps(_deltaTime, *drag, *dir);
+		liveCount--;
+		moveParticle(liveCount, deadParticles[d]);
 	}
 
-#endif
-
-#pragma endregion
-
-
+	//new particles are appended after the live ones and start updating next frame
+	spawnQueued();
 
 }
 
 void ParticleSystem::cleanup()
 {
-	delete[] posX;
-	delete[] posY;
-
-	delete[] directionX;
-	delete[] directionY;
-	delete[] rotation;
-
-	delete[] sizeXY;
-
-	delete[] dragY;
-	delete[] dragX;
-	delete[] duration;
-	delete[] durationTotal;
-	delete[] color;
-	delete[] rotationSpeed;
-	delete[] rotationDrag;
-	delete[] emitTime;
-	delete[] tranzitionType;
-	delete[] deathRattle;
-	delete[] thisParticleSettings;
-	delete[] emitParticle;
-	delete[] textures;
-
+	delete[] arenaAllocation;
+	arenaAllocation = 0;
+	arena = 0;
+	arenaCapacity = 0;
 
 	posX = 0;
 	posY = 0;
@@ -397,55 +1126,150 @@ void ParticleSystem::cleanup()
 	textures = 0;
 
 	size = 0;
+	liveCount = 0;
 
+	workers.reset();
+	threadCount = 1;
+
+	if (instanceVao)
+	{
+		glDeleteVertexArrays(1, &instanceVao);
+		instanceVao = 0;
+	}
+	instanceStream.cleanup();
+	instanceRuns.clear();
+
+	chunkEvents.clear();
+	deadParticles.clear();
+	spawnQueue.clear();
 
 	fb.cleanup();
 }
 
 void ParticleSystem::emitParticleWave(ParticleSettings *ps, glm::vec2 pos)
 {
-	int recreatedParticlesThisFrame = 0;
+	spawnQueue.push_back({ps, pos});
+	spawnQueued();
+}
 
-	for (int i = 0; i < size; i++)
+//Spawns everything in spawnQueue. The slots for all requests are taken at once after liveCount,
+//then every stream is filled in one pass over all of them
+void ParticleSystem::spawnQueued()
+{
+	//free slots are the ones after liveCount, emission costs only the emitted particles
+	const int first = liveCount;
+	for (auto &q : spawnQueue)
 	{
+		q.first = liveCount;
+		q.count = std::min(q.settings->onCreateCount, size - liveCount);
+		liveCount += q.count;
+	}
+
+	if (liveCount == first)
+	{
+		spawnQueue.clear();
+		return;
+	}
 
-		if (recreatedParticlesThisFrame < ps->onCreateCount &&
-			sizeXY[i] == 0)
-		{
-
-			duration[i] = rand(ps->particleLifeTime);
-			durationTotal[i] = duration[i];
-
-			//reset particle
-			posX[i] = pos.x + rand(ps->positionX);
-			posY[i] = pos.y + rand(ps->positionY);
-			directionX[i] = rand(ps->directionX);
-			directionY[i] = rand(ps->directionY);
-			rotation[i] = rand(ps->rotation);;
-			sizeXY[i] = rand(ps->createApearence.size);
-			dragX[i] = rand(ps->dragX);
-			dragY[i] = rand(ps->dragY);
-			color[i].x = rand({ps->createApearence.color1.x, ps->createApearence.color2.x});
-			color[i].y = rand({ps->createApearence.color1.y, ps->createApearence.color2.y});
-			color[i].z = rand({ps->createApearence.color1.z, ps->createApearence.color2.z});
-			color[i].w = rand({ps->createApearence.color1.w, ps->createApearence.color2.w});
-			rotationSpeed[i] = rand(ps->rotationSpeed);
-			rotationDrag[i] = rand(ps->rotationDrag);
+	for (auto &q : spawnQueue)
+	{
+		ParticleSettings *ps = q.settings;
+		for (int i = q.first; i < q.first + q.count; i++)
+		{
 			textures[i] = ps->texturePtr;
 			deathRattle[i] = ps->deathRattle;
 			tranzitionType[i] = ps->tranzitionType;
 			thisParticleSettings[i] = ps;
 			emitParticle[i] = ps->subemitParticle;
-			emitTime[i] = rand(thisParticleSettings[i]->subemitParticleTime);
+		}
+	}
 
-			recreatedParticlesThisFrame++;
+	//requests with the same settings got neighbouring slots, each run of them is filled with one call.
+	//stream holds the particles from streamFirst on
+	auto fillFrom = [&](float *stream, int streamFirst, auto range)
+	{
+		for (size_t r = 0; r < spawnQueue.size();)
+		{
+			ParticleSettings *ps = spawnQueue[r].settings;
+			const int runFirst = spawnQueue[r].first;
+			int runCount = 0;
+			for (; r < spawnQueue.size() && spawnQueue[r].settings == ps; r++)
+			{
+				runCount += spawnQueue[r].count;
+			}
+
+			fillRandom(stream + runFirst - streamFirst, runCount, range(*ps));
 		}
+	};
+
+	auto fill = [&](float *stream, auto range) { fillFrom(stream, 0, range); };
 
+	fill(duration, [](ParticleSettings &ps) { return ps.particleLifeTime; });
+	std::copy(duration + first, duration + liveCount, durationTotal + first);
+
+	//reset particle
+	fill(posX, [](ParticleSettings &ps) { return ps.positionX; });
+	fill(posY, [](ParticleSettings &ps) { return ps.positionY; });
+	for (auto &q : spawnQueue)
+	{
+		for (int i = q.first; i < q.first + q.count; i++)
+		{
+			posX[i] += q.pos.x;
+			posY[i] += q.pos.y;
+		}
+	}
 
+	fill(directionX, [](ParticleSettings &ps) { return ps.directionX; });
+	fill(directionY, [](ParticleSettings &ps) { return ps.directionY; });
+	fill(rotation, [](ParticleSettings &ps) { return ps.rotation; });
+	fill(sizeXY, [](ParticleSettings &ps) { return ps.createApearence.size; });
+	fill(dragX, [](ParticleSettings &ps) { return ps.dragX; });
+	fill(dragY, [](ParticleSettings &ps) { return ps.dragY; });
+	fill(rotationSpeed, [](ParticleSettings &ps) { return ps.rotationSpeed; });
+	fill(rotationDrag, [](ParticleSettings &ps) { return ps.rotationDrag; });
+	fill(emitTime, [](ParticleSettings &ps) { return ps.subemitParticleTime; });
+
+	//color is interleaved so each channel goes through the scratch stream
+	spawnScratch.resize(liveCount - first);
+	for (int c = 0; c < 4; c++)
+	{
+		fillFrom(spawnScratch.data(), first, [c](ParticleSettings &ps)
+		{
+			return glm::vec2{ps.createApearence.color1[c], ps.createApearence.color2[c]};
+		});
 
+		for (int i = first; i < liveCount; i++)
+		{
+			color[i][c] = spawnScratch[i - first];
+		}
 	}
 
+	spawnQueue.clear();
+}
 
+void ParticleSystem::moveParticle(int from, int to)
+{
+	if (from == to) { return; }
+
+	posX[to] = posX[from];
+	posY[to] = posY[from];
+	directionX[to] = directionX[from];
+	directionY[to] = directionY[from];
+	rotation[to] = rotation[from];
+	sizeXY[to] = sizeXY[from];
+	dragX[to] = dragX[from];
+	dragY[to] = dragY[from];
+	duration[to] = duration[from];
+	durationTotal[to] = durationTotal[from];
+	color[to] = color[from];
+	rotationSpeed[to] = rotationSpeed[from];
+	rotationDrag[to] = rotationDrag[from];
+	emitTime[to] = emitTime[from];
+	tranzitionType[to] = tranzitionType[from];
+	deathRattle[to] = deathRattle[from];
+	thisParticleSettings[to] = thisParticleSettings[from];
+	emitParticle[to] = emitParticle[from];
+	textures[to] = textures[from];
 }
 
 float interpolate(float a, float b, float perc)
@@ -478,123 +1302,126 @@ void ParticleSystem::draw(Renderer2D &r)
 	}
 
 
-	for (int i = 0; i < size; i++)
+	if (instancedDraw)
 	{
-		if (sizeXY[i] == 0) { continue; }
+		if (postProcessing)
+		{
+			//same space as the quads get: positions moved by the camera and scaled to the pixelated target
+			gl2d::Camera c = cam;
+			c.position = {};
+
+			GLint target = 0;
+			glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target);
 
-		float lifePerc = duration[i] / durationTotal[i]; //close to 0 when gone, 1 when full
-
-		switch (this->tranzitionType[i])
-		{
-		case gl2d::TRANZITION_TYPES::none:
-		lifePerc = 1;
-		break;
-		case gl2d::TRANZITION_TYPES::linear:
-
-		break;
-		case gl2d::TRANZITION_TYPES::curbe:
-		lifePerc *= lifePerc;
-		break;
-		case gl2d::TRANZITION_TYPES::abruptCurbe:
-		lifePerc *= lifePerc * lifePerc;
-		break;
-		case gl2d::TRANZITION_TYPES::wave:
-		lifePerc = (std::cos(lifePerc * 5 * 3.141592) * lifePerc + lifePerc) / 2.f;
-		break;
-		case gl2d::TRANZITION_TYPES::wave2:
-		lifePerc = std::cos(lifePerc * 5 * 3.141592) * std::sqrt(lifePerc) * 0.9f + 0.1f;
-		break;
-		case gl2d::TRANZITION_TYPES::delay:
-		lifePerc = (std::cos(lifePerc * 3.141592 * 2) * std::sin(lifePerc * lifePerc)) / 2.f;
-		break;
-		case gl2d::TRANZITION_TYPES::delay2:
-		lifePerc = (std::atan(2 * lifePerc * lifePerc * lifePerc * 3.141592)) / 2.f;
-		break;
-		default:
-		break;
-		}
-
-		glm::vec4 pos = {};
-		glm::vec4 c;
-
-		if (thisParticleSettings[i])
-		{
-			pos.x = posX[i];
-			pos.y = posY[i];
-			pos.z = interpolate(sizeXY[i], thisParticleSettings[i]->createEndApearence.size.x, lifePerc);
-			pos.w = pos.z;
-
-			c.x = interpolate(color[i].x, thisParticleSettings[i]->createEndApearence.color1.x, lifePerc);
-			c.y = interpolate(color[i].y, thisParticleSettings[i]->createEndApearence.color1.y, lifePerc);
-			c.z = interpolate(color[i].z, thisParticleSettings[i]->createEndApearence.color1.z, lifePerc);
-			c.w = interpolate(color[i].w, thisParticleSettings[i]->createEndApearence.color1.w, lifePerc);
+			fb.clear();
+			glBindFramebuffer(GL_FRAMEBUFFER, fb.fbo);
+			drawInstanced(c, -cam.position, 1.f / pixelateFactor, r.windowW, r.windowH);
+			glBindFramebuffer(GL_FRAMEBUFFER, target);
 		}
 		else
 		{
-			pos.x = posX[i];
-			pos.y = posY[i];
-			pos.z = sizeXY[i];
-			pos.w = pos.z;
-
-			c.x = color[i].x;
-			c.y = color[i].y;
-			c.z = color[i].z;
-			c.w = color[i].w;
+			//what was queued before goes under the particles
+			r.flush();
+			drawInstanced(cam, {}, 1.f, w, h);
 		}
+	}
+	else
+	{
+		drawQuads.clear();
 
-		glm::vec4 p;
+		evaluateTranzitions();
 
-		if (postProcessing)
+		for (int i = 0; i < liveCount; i++)
 		{
-			r.currentCamera = cam;
+			if (sizeXY[i] == 0) { continue; }
 
-			p = pos / pixelateFactor;
+			const float lifePerc = drawLife[i];
 
-			//p.x += 200;
-			//p.y += 200;
+			glm::vec4 pos = {};
+			glm::vec4 c;
 
-			p.x -= r.currentCamera.position.x / pixelateFactor;
-			p.y -= r.currentCamera.position.y / pixelateFactor;
-			//
+			if (thisParticleSettings[i])
+			{
+				pos.x = posX[i];
+				pos.y = posY[i];
+				pos.z = interpolate(sizeXY[i], thisParticleSettings[i]->createEndApearence.size.x, lifePerc);
+				pos.w = pos.z;
+
+				c.x = interpolate(color[i].x, thisParticleSettings[i]->createEndApearence.color1.x, lifePerc);
+				c.y = interpolate(color[i].y, thisParticleSettings[i]->createEndApearence.color1.y, lifePerc);
+				c.z = interpolate(color[i].z, thisParticleSettings[i]->createEndApearence.color1.z, lifePerc);
+				c.w = interpolate(color[i].w, thisParticleSettings[i]->createEndApearence.color1.w, lifePerc);
+			}
+			else
+			{
+				pos.x = posX[i];
+				pos.y = posY[i];
+				pos.z = sizeXY[i];
+				pos.w = pos.z;
+
+				c.x = color[i].x;
+				c.y = color[i].y;
+				c.z = color[i].z;
+				c.w = color[i].w;
+			}
 
-			r.currentCamera.position = {};
-			//r.currentCamera.position.x += w / (2.f );
-			//r.currentCamera.position.y += h / (2.f );
-			//
-			//r.currentCamera.position /= pixelateFactor/2.f;
-			//
-			//r.currentCamera.position.x -= w / (2.f);
-			//r.currentCamera.position.y -= h / (2.f);
+			glm::vec4 p;
 
+			if (postProcessing)
+			{
+				r.currentCamera = cam;
 
-			//r.currentCamera.position += glm::vec2{w / (pixelateFactor * 2.f), h / (pixelateFactor*2.f)};
-			//r.currentCamera.position *= pixelateFactor;
-			//c.w = sqrt(c.w);
-			// c.w = 1;
-		}
-		else
-		{
-			p = pos;
-		}
+				p = pos / pixelateFactor;
 
+				//p.x += 200;
+				//p.y += 200;
 
-		if (textures[i] != nullptr)
-		{
-			r.renderRectangle(p, *textures[i], c, { 0, 0 }, rotation[i]);
-		}
-		else
-		{
-			r.renderRectangle(p, c, {0,0}, rotation[i]);
-		}
+				p.x -= r.currentCamera.position.x / pixelateFactor;
+				p.y -= r.currentCamera.position.y / pixelateFactor;
+				//
+
+				r.currentCamera.position = {};
+				//r.currentCamera.position.x += w / (2.f );
+				//r.currentCamera.position.y += h / (2.f );
+				//
+				//r.currentCamera.position /= pixelateFactor/2.f;
+				//
+				//r.currentCamera.position.x -= w / (2.f);
+				//r.currentCamera.position.y -= h / (2.f);
+
+
+				//r.currentCamera.position += glm::vec2{w / (pixelateFactor * 2.f), h / (pixelateFactor*2.f)};
+				//r.currentCamera.position *= pixelateFactor;
+				//c.w = sqrt(c.w);
+				// c.w = 1;
+			}
+			else
+			{
+				p = pos;
+			}
+
+
+			gl2d::QuadDescriptor quad;
+			quad.rect = p;
+			quad.rotation = rotation[i];
+			quad.color = c;
+			quad.texture = textures[i] != nullptr ? textures[i]->id : 0;
+			drawQuads.push_back(quad);
 
+		}
 
+		//the camera is the same for every particle by now
+		r.renderQuads(drawQuads.data(), drawQuads.size());
 	}
 
 
 	if (postProcessing)
 	{
-		fb.clear();
-		r.flushFBO(fb);
+		if (!instancedDraw)
+		{
+			fb.clear();
+			r.flushFBO(fb);
+		}
 
 
 
@@ -617,6 +1444,110 @@ void ParticleSystem::draw(Renderer2D &r)
 
 }
 
+static uint32_t packParticleColor(glm::vec4 c)
+{
+	c = glm::clamp(c, 0.f, 1.f) * 255.f + 0.5f;
+	return (uint32_t)c.x | ((uint32_t)c.y << 8) | ((uint32_t)c.z << 16) | ((uint32_t)c.w << 24);
+}
+
+//Writes one ParticleInstance per visible particle into instanceStream and draws them,
+//one instanced draw per run of the same texture. Draws to whatever framebuffer is bound
+void ParticleSystem::drawInstanced(const gl2d::Camera &camera, glm::vec2 offset, float scale, int w, int h)
+{
+	if (!liveCount || w <= 0 || h <= 0) { return; }
+
+	if (!instanceVao)
+	{
+		glGenVertexArrays(1, &instanceVao);
+		glBindVertexArray(instanceVao);
+		for (int a = 0; a < 4; a++)
+		{
+			glEnableVertexAttribArray(a);
+			glVertexAttribDivisor(a, 1);
+		}
+		glBindVertexArray(0);
+
+		instanceStream.create(sizeof(ParticleInstance) * size);
+	}
+
+	size_t bufferOffset = 0;
+	ParticleInstance *out = (ParticleInstance *)instanceStream.beginWrite(sizeof(ParticleInstance) * liveCount, bufferOffset);
+
+	instanceRuns.clear();
+	int count = 0;
+	for (int i = 0; i < liveCount; i++)
+	{
+		if (sizeXY[i] == 0) { continue; }
+
+		const ParticleSettings *ps = thisParticleSettings[i];
+		ParticleInstance &p = out[count];
+
+		p.x = posX[i];
+		p.y = posY[i];
+		p.size = sizeXY[i];
+		p.endSize = ps ? ps->createEndApearence.size.x : sizeXY[i];
+		p.rotation = rotation[i];
+		p.life = duration[i] / durationTotal[i];
+		p.tranzitionType = tranzitionType[i];
+		p.color = packParticleColor(color[i]);
+		p.endColor = ps ? packParticleColor(ps->createEndApearence.color1) : p.color;
+
+		const GLuint texture = textures[i] != nullptr ? textures[i]->id : particleWhiteTexture.id;
+		if (instanceRuns.empty() || instanceRuns.back().texture != texture)
+		{
+			instanceRuns.push_back({texture, count, 0});
+		}
+		instanceRuns.back().count++;
+
+		count++;
+	}
+
+	instanceStream.endWrite();
+
+	if (!count) { return; }
+
+	enableNecessaryGLFeatures();
+	glViewport(0, 0, w, h);
+
+	glBindVertexArray(instanceVao);
+	glUseProgram(instancedParticleShader.id);
+	glUniform1i(instancedParticleShader.u_sampler, 0);
+
+	const glm::mat4 viewProjection = camera.getViewProjection((float)w, (float)h);
+	glUniformMatrix4fv(instancedParticleShader.u_viewProjection, 1, GL_FALSE, &viewProjection[0][0]);
+	glUniform3f(instancedOffsetScale, offset.x, offset.y, scale);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceStream.buffer);
+
+	//no base instance in opengl 3.3, each run points the attributes at its first instance
+	const GLsizei stride = sizeof(ParticleInstance);
+	for (const InstanceRun &run : instanceRuns)
+	{
+		const size_t base = bufferOffset + run.first * sizeof(ParticleInstance);
+
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(ParticleInstance, x)));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(ParticleInstance, rotation)));
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)(base + offsetof(ParticleInstance, color)));
+		glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)(base + offsetof(ParticleInstance, endColor)));
+
+		glBindTexture(GL_TEXTURE_2D, run.texture);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, run.count);
+	}
+
+	glBindVertexArray(0);
+}
+
+void ParticleSystem::fillRandom(float *out, int count, glm::vec2 range)
+{
+	if (range.x > range.y)
+	{
+		std::swap(range.x, range.y);
+	}
+
+	random.fillUniform(out, count, range.x, range.y);
+}
+
 float ParticleSystem::rand(glm::vec2 v)
 {
 	if (v.x > v.y)
@@ -624,19 +1555,133 @@ float ParticleSystem::rand(glm::vec2 v)
 		std::swap(v.x, v.y);
 	}
 
-	std::uniform_real_distribution<float> dist(v.x, v.y);
+	return random.uniform(v.x, v.y);
+}
+
+#pragma region ParticleRandom
+
+namespace
+{
+	inline uint32_t rotateLeft(uint32_t x, int k)
+	{
+		return (x << k) | (x >> (32 - k));
+	}
+
+	//top 24 bits as a float in [0, 1)
+	inline float unitFloat(uint32_t x)
+	{
+		return (float)(x >> 8) * (1.f / 16777216.f);
+	}
+}
+
+void ParticleRandom::seed(uint64_t seed)
+{
+	//splitmix64 spreads the seed over every lane, it never gives an all zero lane
+	for (int l = 0; l < LANES; l++)
+	{
+		for (int w = 0; w < 4; w += 2)
+		{
+			uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			z = z ^ (z >> 31);
+
+			state[w][l] = (uint32_t)z;
+			state[w + 1][l] = (uint32_t)(z >> 32);
+		}
+	}
+
+	bufferedCount = 0;
+}
+
+//one xoshiro128+ step on every lane. The state is copied to locals so the compiler
+//knows out does not alias it and keeps each line in one register
+void ParticleRandom::step(uint32_t *out)
+{
+	uint32_t s0[LANES], s1[LANES], s2[LANES], s3[LANES];
+	for (int l = 0; l < LANES; l++)
+	{
+		s0[l] = state[0][l];
+		s1[l] = state[1][l];
+		s2[l] = state[2][l];
+		s3[l] = state[3][l];
+	}
+
+	for (int l = 0; l < LANES; l++)
+	{
+		out[l] = s0[l] + s3[l];
+
+		const uint32_t t = s1[l] << 9;
+
+		s2[l] ^= s0[l];
+		s3[l] ^= s1[l];
+		s1[l] ^= s2[l];
+		s0[l] ^= s3[l];
+
+		s2[l] ^= t;
+
+		s3[l] = rotateLeft(s3[l], 11);
+	}
+
+	for (int l = 0; l < LANES; l++)
+	{
+		state[0][l] = s0[l];
+		state[1][l] = s1[l];
+		state[2][l] = s2[l];
+		state[3][l] = s3[l];
+	}
+}
+
+float ParticleRandom::next()
+{
+	if (bufferedCount == 0)
+	{
+		step(buffered);
+		bufferedCount = LANES;
+	}
+
+	return unitFloat(buffered[--bufferedCount]);
+}
+
+void ParticleRandom::fillUniform(float *out, int count, float min, float max)
+{
+	const float scale = max - min;
+
+	int i = 0;
+	for (; i + LANES <= count; i += LANES)
+	{
+		uint32_t bits[LANES];
+		step(bits);
+
+		for (int l = 0; l < LANES; l++)
+		{
+			out[i + l] = min + unitFloat(bits[l]) * scale;
+		}
+	}
 
-	return dist(random);
+	for (; i < count; i++)
+	{
+		out[i] = min + next() * scale;
+	}
 }
 
+#pragma endregion
+
 void initgl2dParticleSystem()
 {
 	defaultParticleShader = createShaderProgram(defaultParticleVertexShader, defaultParcileFragmentShader);
+
+	instancedParticleShader = createShaderProgram(instancedParticleVertexShader, instancedParticleFragmentShader);
+	instancedOffsetScale = glGetUniformLocation(instancedParticleShader.id, "u_offsetScale");
+
+	particleWhiteTexture.create1PxSquare();
 }
 
 void cleanupgl2dParticleSystem()
 {
-	glDeleteShader(defaultParticleShader.id);
+	glDeleteProgram(defaultParticleShader.id);
+	glDeleteProgram(instancedParticleShader.id);
+	particleWhiteTexture.cleanup();
 }
 
 
@@ -0,0 +1,86 @@
+//StreamBuffer::alloc ring logic: exact fit allocations must wrap back to 0 and never leave the buffer.
+//The sync calls go to fakes so no gl context is needed.
+#include <gl2d/gl2d.h>
+#include <cstdio>
+
+static int fencesCreated = 0;
+static int fencesWaited = 0;
+
+static GLsync APIENTRY fakeFenceSync(GLenum, GLbitfield)
+{
+	return (GLsync)(size_t)(++fencesCreated);
+}
+
+static void APIENTRY fakeDeleteSync(GLsync)
+{
+}
+
+static GLenum APIENTRY fakeClientWaitSync(GLsync, GLbitfield, GLuint64)
+{
+	fencesWaited++;
+	return GL_ALREADY_SIGNALED;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, int step, size_t value)
+{
+	if (!ok)
+	{
+		std::printf("FAIL %s (step %d, value %zu)\n", what, step, value);
+		failures++;
+	}
+}
+
+//allocates size bytes frames times, every offset has to be in the buffer and
+//the expected one if expectedStride is given (offset = step * expectedStride mod buffer)
+static void runExactFit(size_t regionSize, size_t size, int frames, size_t expectedStride)
+{
+	gl2d::StreamBuffer s;
+	s.regionSize = regionSize; //no storage, alloc only does the ring math and the fences
+
+	const size_t total = gl2d::StreamBuffer::REGIONS * regionSize;
+	for (int f = 0; f < frames; f++)
+	{
+		const size_t offset = s.alloc(size);
+
+		check(offset + size <= total, "allocation inside the buffer", f, offset);
+		check(s.region >= 0 && s.region < gl2d::StreamBuffer::REGIONS, "region index in range", f, (size_t)s.region);
+		check(offset % regionSize + size <= regionSize, "allocation inside one region", f, offset);
+
+		if (expectedStride)
+		{
+			check(offset == (f * expectedStride) % total, "offset wraps around", f, offset);
+		}
+	}
+}
+
+int main()
+{
+	glad_glFenceSync = fakeFenceSync;
+	glad_glDeleteSync = fakeDeleteSync;
+	glad_glClientWaitSync = fakeClientWaitSync;
+
+	//RectBatch::Create(256): 7168 byte regions, 64 rects of 112 bytes fill one exactly
+	runExactFit(7168, 64 * 112, 100, 7168);
+	check(fencesCreated == 99, "a fence for every region left", 0, (size_t)fencesCreated);
+	check(fencesWaited >= 96, "every reused region waited on", 0, (size_t)fencesWaited);
+
+	//two exact halves per region
+	runExactFit(4096, 2048, 100, 2048);
+
+	//sizes that don't divide the region, the tail of each region is skipped
+	runExactFit(1000, 304, 100, 0);
+
+	//the particle instance stream with a full pool: 16 particles of 36 bytes, one region per frame
+	runExactFit(16 * 36, 16 * 36, 100, 16 * 36);
+
+	if (failures)
+	{
+		std::printf("%d checks failed\n", failures);
+		return 1;
+	}
+
+	std::printf("stream buffer ok\n");
+	return 0;
+}